@@ -0,0 +1,164 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "BufferInit.h"
+#include "pch.h"
+
+#include <emmintrin.h>
+
+using std::chrono::duration_cast, std::chrono::milliseconds, std::chrono::steady_clock, std::thread;
+
+BufferInit::BufferInit(int power, int threads)
+{
+    count = (uint64_t)1 << power;
+    bytes = count << 2;
+    nChunks = (bytes + INIT_CHUNK_SIZE - 1) / INIT_CHUNK_SIZE;
+    nThreads = (int)max((uint64_t)1, min((uint64_t)threads, nChunks));
+
+    ULONG highestNode = 0;
+    nNodes = GetNumaHighestNodeNumber(&highestNode) ? (int)highestNode + 1 : 1;
+
+    // committed but untouched: each page is placed when a worker first writes it
+    buf = (DWORD *)VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!buf)
+    {
+        printf("VirtualAlloc() failed with %d\n", GetLastError());
+        exit(EXIT_FAILURE);
+    }
+
+    workers = new thread[nThreads];
+    done = new std::atomic<bool>[nChunks];
+    for (uint64_t c = 0; c < nChunks; ++c)
+    {
+        done[c] = false;
+    }
+    chunkDone = CreateEvent(NULL, false, false, NULL);
+}
+
+BufferInit::~BufferInit()
+{
+    Join();
+    delete[] workers;
+    delete[] done;
+    CloseHandle(chunkDone);
+    VirtualFree(buf, 0, MEM_RELEASE);
+}
+
+DWORD *BufferInit::getBuffer()
+{
+    return buf;
+}
+
+int BufferInit::getThreads()
+{
+    return nThreads;
+}
+
+int BufferInit::getNodes()
+{
+    return nNodes;
+}
+
+// valid after Join()
+long long BufferInit::getElapsedMs()
+{
+    return elapsedMs;
+}
+
+// dst[i] = first + i with 16-byte streaming stores; dst must be 16-byte aligned
+void BufferInit::Fill(DWORD *dst, uint64_t first, uint64_t n)
+{
+    DWORD f = (DWORD)first;
+    __m128i v = _mm_setr_epi32(f, f + 1, f + 2, f + 3);
+    const __m128i step = _mm_set1_epi32(4);
+    __m128i *out = (__m128i *)dst;
+    uint64_t i = 0;
+
+    // non-temporal stores skip the read-for-ownership of pages nobody has touched yet
+    for (; i + 16 <= n; i += 16, out += 4)
+    {
+        _mm_stream_si128(out, v);
+        v = _mm_add_epi32(v, step);
+        _mm_stream_si128(out + 1, v);
+        v = _mm_add_epi32(v, step);
+        _mm_stream_si128(out + 2, v);
+        v = _mm_add_epi32(v, step);
+        _mm_stream_si128(out + 3, v);
+        v = _mm_add_epi32(v, step);
+    }
+    for (; i < n; ++i)
+    {
+        dst[i] = (DWORD)(first + i);
+    }
+    // streaming stores are weakly ordered, make them visible before the chunk is marked done
+    _mm_sfence();
+}
+
+void BufferInit::FillRun(int id)
+{
+    // spread the threads evenly over the nodes, neighbors share a node
+    if (nNodes > 1)
+    {
+        GROUP_AFFINITY affinity;
+        memset(&affinity, 0, sizeof(affinity));
+        USHORT node = (USHORT)((uint64_t)id * nNodes / nThreads);
+        if (GetNumaNodeProcessorMaskEx(node, &affinity) && affinity.Mask != 0)
+        {
+            SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+        }
+    }
+
+    uint64_t perChunk = INIT_CHUNK_SIZE >> 2;
+    for (uint64_t c = id; c < nChunks; c += nThreads)
+    {
+        uint64_t first = c * perChunk;
+        Fill(buf + first, first, min(perChunk, count - first));
+        done[c] = true;
+        SetEvent(chunkDone);
+    }
+
+    if (--running == 0)
+    {
+        elapsedMs = duration_cast<milliseconds>(steady_clock::now() - started).count();
+    }
+}
+
+void BufferInit::Start()
+{
+    started = steady_clock::now();
+    running = nThreads;
+    for (int i = 0; i < nThreads; ++i)
+    {
+        workers[i] = thread(&BufferInit::FillRun, this, i);
+    }
+}
+
+// blocks until the first byteCount bytes are filled, returns how many bytes are ready
+uint64_t BufferInit::WaitUntil(uint64_t byteCount)
+{
+    uint64_t need = min(bytes, byteCount);
+    while (readyChunks * INIT_CHUNK_SIZE < need)
+    {
+        if (done[readyChunks])
+        {
+            ++readyChunks;
+            continue;
+        }
+        WaitForSingleObject(chunkDone, INFINITE);
+    }
+    return min(bytes, readyChunks * INIT_CHUNK_SIZE);
+}
+
+void BufferInit::Join()
+{
+    for (int i = 0; i < nThreads; ++i)
+    {
+        if (workers[i].joinable())
+        {
+            workers[i].join();
+        }
+    }
+}
@@ -0,0 +1,55 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// CONSTANTS
+#define INIT_CHUNK_SIZE (4 << 20) // bytes filled per unit of work, a multiple of the page size
+
+// fills the DWORD array 0, 1, 2, ... on several threads; chunk c belongs to thread
+// c % threads, so the filled prefix grows roughly in order and the send loop can
+// start on it early, and each thread is pinned to a NUMA node and is the first to
+// touch its chunks, so their pages are allocated on that node
+class BufferInit
+{
+	friend class SelfTest; // checks Fill() on sizes a power-of-two buffer never produces
+
+private:
+	DWORD *buf;
+	uint64_t count; // DWORDs
+	uint64_t bytes;
+	uint64_t nChunks;
+	int nThreads;
+	int nNodes;
+	std::thread *workers;
+	std::atomic<bool> *done;
+	HANDLE chunkDone;
+	uint64_t readyChunks = 0; // contiguous filled prefix, only used by the waiting thread
+	std::atomic<int> running{0};
+	std::chrono::steady_clock::time_point started;
+	long long elapsedMs = 0;
+
+	// helpers
+	void FillRun(int id);
+	static void Fill(DWORD *dst, uint64_t first, uint64_t n);
+
+public:
+	BufferInit(int power, int threads);
+	~BufferInit();
+	DWORD *getBuffer();
+	int getThreads();
+	int getNodes();
+	long long getElapsedMs();
+	void Start();
+	uint64_t WaitUntil(uint64_t byteCount);
+	void Join();
+};
@@ -0,0 +1,476 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "Compressor.h"
+#include "pch.h"
+
+using std::thread;
+
+// LZ4 block format limits
+#define MIN_MATCH 4
+#define LAST_LITERALS 5 // last 5 bytes of a block are always literals
+#define MF_LIMIT 12     // last match must start at least 12 bytes before the end
+#define HASH_LOG 12
+#define MAX_OFFSET 65535
+
+static inline DWORD read32(const BYTE *p)
+{
+    DWORD v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline DWORD hash4(DWORD v)
+{
+    return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+static BYTE *writeLength(BYTE *op, int len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (BYTE)len;
+    return op;
+}
+
+int BlockCompressor::Compress(const char *source, int srcSize, char *dest, int dstCapacity)
+{
+    const BYTE *src = (const BYTE *)source;
+    const BYTE *ip = src;
+    const BYTE *anchor = src;
+    const BYTE *end = src + srcSize;
+    BYTE *op = (BYTE *)dest;
+    BYTE *opEnd = op + dstCapacity;
+
+    if (srcSize >= MF_LIMIT + 1)
+    {
+        // positions of the last occurrence of each hashed 4-byte sequence
+        DWORD table[1 << HASH_LOG];
+        memset(table, 0, sizeof(table));
+
+        const BYTE *matchLimit = end - LAST_LITERALS;
+        const BYTE *mfLimit = end - MF_LIMIT;
+        while (ip <= mfLimit)
+        {
+            DWORD seq = read32(ip);
+            DWORD h = hash4(seq);
+            const BYTE *ref = src + table[h];
+            table[h] = (DWORD)(ip - src);
+
+            if (ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != seq)
+            {
+                // step faster through data that keeps missing
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            const BYTE *mp = ip + MIN_MATCH;
+            const BYTE *rp = ref + MIN_MATCH;
+            while (mp < matchLimit && *mp == *rp)
+            {
+                ++mp;
+                ++rp;
+            }
+
+            int litLen = (int)(ip - anchor);
+            int matchLen = (int)(mp - ip) - MIN_MATCH;
+            if (op + 1 + litLen + (litLen / 255) + 1 + 2 + (matchLen / 255) + 1 > opEnd)
+            {
+                return 0;
+            }
+
+            // token: literal length in the high nibble, match length in the low nibble
+            BYTE *token = op++;
+            *token = (BYTE)(min(litLen, 15) << 4);
+            if (litLen >= 15)
+            {
+                op = writeLength(op, litLen - 15);
+            }
+            memcpy(op, anchor, litLen);
+            op += litLen;
+
+            WORD offset = (WORD)(ip - ref);
+            *op++ = (BYTE)(offset & 0xFF);
+            *op++ = (BYTE)(offset >> 8);
+
+            *token |= (BYTE)min(matchLen, 15);
+            if (matchLen >= 15)
+            {
+                op = writeLength(op, matchLen - 15);
+            }
+
+            ip = mp;
+            anchor = ip;
+        }
+    }
+
+    // remaining bytes go out as a final literal run
+    int litLen = (int)(end - anchor);
+    if (op + 1 + litLen + (litLen / 255) + 1 > opEnd)
+    {
+        return 0;
+    }
+    BYTE *token = op++;
+    *token = (BYTE)(min(litLen, 15) << 4);
+    if (litLen >= 15)
+    {
+        op = writeLength(op, litLen - 15);
+    }
+    memcpy(op, anchor, litLen);
+    op += litLen;
+
+    return (int)(op - (BYTE *)dest);
+}
+
+int BlockCompressor::Decompress(const char *source, int srcSize, char *dest, int dstCapacity)
+{
+    const BYTE *ip = (const BYTE *)source;
+    const BYTE *end = ip + srcSize;
+    BYTE *dst = (BYTE *)dest;
+    BYTE *op = dst;
+    BYTE *opEnd = dst + dstCapacity;
+
+    while (ip < end)
+    {
+        BYTE token = *ip++;
+
+        // literals
+        int litLen = token >> 4;
+        if (litLen == 15)
+        {
+            BYTE b;
+            do
+            {
+                if (ip >= end)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                litLen += b;
+            } while (b == 255);
+        }
+        if (litLen > end - ip || litLen > opEnd - op)
+        {
+            return -1;
+        }
+        memcpy(op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+
+        // the final sequence has no match part
+        if (ip == end)
+        {
+            break;
+        }
+
+        if (end - ip < 2)
+        {
+            return -1;
+        }
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - dst)
+        {
+            return -1;
+        }
+
+        int matchLen = token & 0x0F;
+        if (matchLen == 15)
+        {
+            BYTE b;
+            do
+            {
+                if (ip >= end)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                matchLen += b;
+            } while (b == 255);
+        }
+        matchLen += MIN_MATCH;
+        if (matchLen > opEnd - op)
+        {
+            return -1;
+        }
+
+        // byte copy so overlapping matches repeat correctly
+        const BYTE *ref = op - offset;
+        for (int i = 0; i < matchLen; ++i)
+        {
+            op[i] = ref[i];
+        }
+        op += matchLen;
+    }
+
+    return (int)(op - dst);
+}
+
+int BlockCompressor::DecodeBlock(const char *block, int bytes, char *dst, int dstCapacity)
+{
+    if (bytes < (int)sizeof(CompressedBlockHeader))
+    {
+        return -1;
+    }
+    CompressedBlockHeader hdr;
+    memcpy(&hdr, block, sizeof(CompressedBlockHeader));
+    const char *payload = block + sizeof(CompressedBlockHeader);
+    if (hdr.compSize != bytes - sizeof(CompressedBlockHeader) || hdr.rawSize > (DWORD)dstCapacity)
+    {
+        return -1;
+    }
+    int rawSize = hdr.rawSize;
+
+    switch (hdr.method)
+    {
+    case BLOCK_STORED:
+        if (hdr.compSize != hdr.rawSize)
+        {
+            return -1;
+        }
+        memcpy(dst, payload, rawSize);
+        return rawSize;
+    case BLOCK_LZ:
+        return Decompress(payload, hdr.compSize, dst, rawSize) == rawSize ? rawSize : -1;
+    case BLOCK_DELTA_LZ:
+    {
+        if (rawSize % sizeof(DWORD) != 0 || Decompress(payload, hdr.compSize, dst, rawSize) != rawSize)
+        {
+            return -1;
+        }
+        // running sum turns the deltas back into the DWORDs
+        DWORD *w = (DWORD *)dst;
+        int count = rawSize / sizeof(DWORD);
+        for (int i = 1; i < count; ++i)
+        {
+            w[i] += w[i - 1];
+        }
+        return rawSize;
+    }
+    }
+    return -1;
+}
+
+BlockDecoder::BlockDecoder()
+{
+    block = new char[sizeof(CompressedBlockHeader) + COMPRESS_BOUND(COMPRESS_BLOCK_SIZE)];
+    out = new char[COMPRESS_BLOCK_SIZE];
+}
+
+BlockDecoder::~BlockDecoder()
+{
+    delete[] block;
+    delete[] out;
+}
+
+// returns the original bytes decoded and added to crc, or -1 once the stream is malformed
+int BlockDecoder::Feed(const char *data, int bytes, RunningChecksum &crc)
+{
+    int decoded = 0;
+    while (bytes > 0 && !failed)
+    {
+        int headerSize = sizeof(CompressedBlockHeader);
+        if (have < headerSize)
+        {
+            int take = min(bytes, headerSize - have);
+            memcpy(block + have, data, take);
+            have += take;
+            data += take;
+            bytes -= take;
+            continue;
+        }
+
+        CompressedBlockHeader hdr;
+        memcpy(&hdr, block, headerSize);
+        if (hdr.rawSize > COMPRESS_BLOCK_SIZE || hdr.compSize > COMPRESS_BOUND(COMPRESS_BLOCK_SIZE))
+        {
+            failed = true;
+            break;
+        }
+        int total = headerSize + hdr.compSize;
+        int take = min(bytes, total - have);
+        memcpy(block + have, data, take);
+        have += take;
+        data += take;
+        bytes -= take;
+        if (have < total)
+        {
+            break;
+        }
+
+        int rawSize = BlockCompressor::DecodeBlock(block, total, out, COMPRESS_BLOCK_SIZE);
+        if (rawSize < 0)
+        {
+            failed = true;
+            break;
+        }
+        crc.Update((const unsigned char *)out, rawSize);
+        decoded += rawSize;
+        have = 0;
+    }
+    return failed ? -1 : decoded;
+}
+
+CompressionStage::CompressionStage(const char *buf, uint64_t bytes, int threads)
+{
+    src = buf;
+    srcSize = bytes;
+    blockCount = (srcSize + COMPRESS_BLOCK_SIZE - 1) / COMPRESS_BLOCK_SIZE;
+    nThreads = threads;
+
+    // every worker owns the slots (id, id + nThreads, ...), so each slot has a single writer
+    ringSize = 2 * nThreads;
+    ring = new CompressedBlock[ringSize];
+    for (int i = 0; i < ringSize; ++i)
+    {
+        ring[i].size = 0;
+        ring[i].ready = CreateEvent(NULL, false, false, NULL);
+        ring[i].free = CreateEvent(NULL, false, true, NULL);
+    }
+    eventQuit = CreateEvent(NULL, true, false, NULL);
+
+    for (int i = 0; i < nThreads; ++i)
+    {
+        workers.push_back(thread(&CompressionStage::WorkerRun, this, i));
+    }
+}
+
+CompressionStage::~CompressionStage()
+{
+    SetEvent(eventQuit);
+    for (thread &t : workers)
+    {
+        t.join();
+    }
+    for (int i = 0; i < ringSize; ++i)
+    {
+        CloseHandle(ring[i].ready);
+        CloseHandle(ring[i].free);
+    }
+    CloseHandle(eventQuit);
+    delete[] ring;
+}
+
+void CompressionStage::compressBlock(uint64_t index, CompressedBlock *slot, char *scratch)
+{
+    const char *in = src + index * COMPRESS_BLOCK_SIZE;
+    int rawSize = (int)min((uint64_t)COMPRESS_BLOCK_SIZE, srcSize - index * COMPRESS_BLOCK_SIZE);
+
+    CompressedBlockHeader hdr;
+    hdr.rawSize = rawSize;
+    hdr.method = BLOCK_LZ;
+
+    // counters, indices and timestamps compress far better as DWORD deltas;
+    // sample the first 256 deltas and switch when most of them repeat
+    if (rawSize % sizeof(DWORD) == 0 && rawSize >= 64 * sizeof(DWORD))
+    {
+        const DWORD *w = (const DWORD *)in;
+        int n = min(rawSize / (int)sizeof(DWORD), 257);
+        int repeats = 0;
+        for (int i = 2; i < n; ++i)
+        {
+            repeats += (w[i] - w[i - 1] == w[i - 1] - w[i - 2]);
+        }
+        if (repeats > n / 2)
+        {
+            DWORD *d = (DWORD *)scratch;
+            int count = rawSize / sizeof(DWORD);
+            d[0] = w[0];
+            for (int i = 1; i < count; ++i)
+            {
+                d[i] = w[i] - w[i - 1];
+            }
+            in = scratch;
+            hdr.method = BLOCK_DELTA_LZ;
+        }
+    }
+
+    char *payload = slot->data + sizeof(CompressedBlockHeader);
+    int compSize = BlockCompressor::Compress(in, rawSize, payload, rawSize);
+    if (compSize == 0)
+    {
+        // incompressible, store it as is
+        memcpy(payload, src + index * COMPRESS_BLOCK_SIZE, rawSize);
+        compSize = rawSize;
+        hdr.method = BLOCK_STORED;
+    }
+    hdr.compSize = compSize;
+
+    memcpy(slot->data, &hdr, sizeof(CompressedBlockHeader));
+    slot->size = sizeof(CompressedBlockHeader) + compSize;
+}
+
+void CompressionStage::WorkerRun(int id)
+{
+    char *scratch = new char[COMPRESS_BLOCK_SIZE];
+
+    for (uint64_t i = id; i < blockCount; i += nThreads)
+    {
+        CompressedBlock *slot = ring + (i % ringSize);
+
+        HANDLE events[] = {slot->free, eventQuit};
+        DWORD result = WaitForMultipleObjects(2, events, false, INFINITE);
+        if (result == WAIT_FAILED || result == WAIT_ABANDONED)
+        {
+            printf("WaitForMultipleObjects() failed with %d\n", GetLastError());
+            exit(EXIT_FAILURE);
+        }
+        if (result == WAIT_OBJECT_0 + 1)
+        {
+            break;
+        }
+
+        compressBlock(i, slot, scratch);
+        SetEvent(slot->ready);
+    }
+
+    delete[] scratch;
+}
+
+// hands out blocks in order; the previous block is recycled on the next call
+bool CompressionStage::Next(char *&block, int &bytes)
+{
+    if (nextOut > 0)
+    {
+        SetEvent(ring[(nextOut - 1) % ringSize].free);
+    }
+    if (nextOut == blockCount)
+    {
+        return false;
+    }
+
+    CompressedBlock *slot = ring + (nextOut % ringSize);
+    DWORD result = WaitForSingleObject(slot->ready, INFINITE);
+    if (result == WAIT_FAILED || result == WAIT_ABANDONED)
+    {
+        printf("WaitForSingleObject() failed with %d\n", GetLastError());
+        exit(EXIT_FAILURE);
+    }
+
+    block = slot->data;
+    bytes = slot->size;
+    compressedBytes += bytes;
+    ++nextOut;
+    return true;
+}
+
+uint64_t CompressionStage::getRawBytes()
+{
+    return srcSize;
+}
+
+uint64_t CompressionStage::getCompressedBytes()
+{
+    return compressedBytes;
+}
+
+double CompressionStage::getRatio()
+{
+    return compressedBytes ? (double)srcSize / compressedBytes : 0.0;
+}
@@ -0,0 +1,98 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include <windows.h>
+#include "RunningChecksum.h"
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// CONSTANTS
+#define COMPRESS_BLOCK_SIZE (1 << 16)              // input bytes per independent block
+#define COMPRESS_BOUND(n) ((n) + ((n) / 255) + 16) // worst-case output for n input bytes
+
+// block methods
+#define BLOCK_STORED 0   // payload is the raw input
+#define BLOCK_LZ 1       // payload is an LZ4-format block
+#define BLOCK_DELTA_LZ 2 // DWORD deltas of the input, then LZ4-format block
+
+#pragma pack(push, 1)
+class CompressedBlockHeader
+{
+public:
+	DWORD rawSize;  // input bytes covered by this block
+	DWORD compSize; // payload bytes that follow this header
+	BYTE method;    // BLOCK_STORED, BLOCK_LZ or BLOCK_DELTA_LZ
+};
+#pragma pack(pop)
+
+// stateless LZ4-style block codec, every block is independent of the others
+class BlockCompressor
+{
+public:
+	// returns compressed size, or 0 when the output would not fit in dstCapacity
+	static int Compress(const char *src, int srcSize, char *dst, int dstCapacity);
+	// returns decompressed size, or -1 on malformed input
+	static int Decompress(const char *src, int srcSize, char *dst, int dstCapacity);
+	// undoes one header + payload built by CompressionStage, returns rawSize or -1 on malformed input
+	static int DecodeBlock(const char *block, int bytes, char *dst, int dstCapacity);
+};
+
+// receiver side: collects the blocks out of in-order packet payloads (a block may
+// span packets, a packet may hold several blocks) and checksums the original bytes
+class BlockDecoder
+{
+private:
+	char *block; // header + payload of the block being collected
+	int have = 0;
+	char *out;
+	bool failed = false;
+
+public:
+	BlockDecoder();
+	~BlockDecoder();
+	int Feed(const char *data, int bytes, RunningChecksum &crc);
+};
+
+class CompressedBlock
+{
+public:
+	int size; // header + payload
+	HANDLE ready; // set by the owning worker once data is filled in
+	HANDLE free;  // set by the consumer once data has been sent
+	char data[sizeof(CompressedBlockHeader) + COMPRESS_BOUND(COMPRESS_BLOCK_SIZE)];
+};
+
+class CompressionStage
+{
+private:
+	const char *src;
+	uint64_t srcSize;
+	uint64_t blockCount;
+	uint64_t nextOut = 0;
+	int nThreads;
+	int ringSize;
+	CompressedBlock *ring;
+	std::vector<std::thread> workers;
+	HANDLE eventQuit;
+
+	// stats variables
+	uint64_t compressedBytes = 0;
+
+	// helpers
+	void WorkerRun(int id);
+	void compressBlock(uint64_t index, CompressedBlock *slot, char *scratch);
+
+public:
+	CompressionStage(const char *buf, uint64_t bytes, int threads);
+	~CompressionStage();
+	bool Next(char *&block, int &bytes);
+	uint64_t getRawBytes();
+	uint64_t getCompressedBytes();
+	double getRatio();
+};
@@ -0,0 +1,732 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "FanoutSenderSocket.h"
+#include "pch.h"
+
+using std::chrono::duration, std::chrono::duration_cast, std::chrono::steady_clock, std::thread;
+
+static uint64_t addressKey(const sockaddr_in &addr)
+{
+    return ((uint64_t)addr.sin_addr.s_addr << 16) | addr.sin_port;
+}
+
+void FanoutReceiver::transmit(const char *buf, int bytes)
+{
+    if (sendto(owner->sock, buf, bytes, 0, (sockaddr *)&remote, sizeof(remote)) == SOCKET_ERROR)
+    {
+        printf("sendto() failed with %d\n", WSAGetLastError());
+    }
+}
+
+// our core moved its base, so we stop holding those ring slots
+void FanoutReceiver::releaseSlots(int count)
+{
+    owner->releaseThrough(releasedBase, core->senderBase);
+    releasedBase = core->senderBase;
+}
+
+// Close() waits on the ring as a whole, not on one receiver
+void FanoutReceiver::allAcked()
+{
+}
+
+FanoutSenderSocket::FanoutSenderSocket()
+{
+    // open UDP socket and bind
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == INVALID_SOCKET)
+    {
+        printf("socket() generated error %d\n", WSAGetLastError());
+        WSACleanup();
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+    local.sin_port = htons(0);
+    if (bind(sock, (sockaddr *)&local, sizeof(local)) == SOCKET_ERROR)
+    {
+        printf("bind() generated error %d\n", WSAGetLastError());
+        WSACleanup();
+        exit(EXIT_FAILURE);
+    }
+
+    constructedTime = steady_clock::now();
+}
+
+void FanoutSenderSocket::closeSocket()
+{
+    if (sock != INVALID_SOCKET)
+    {
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+}
+
+FanoutSenderSocket::~FanoutSenderSocket()
+{
+    // a Send() or Close() that failed leaves the threads running
+    if (worker.joinable() || stats.joinable())
+    {
+        SetEvent(eventQuit);
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        if (stats.joinable())
+        {
+            stats.join();
+        }
+    }
+    closeSocket();
+    for (FanoutReceiver &r : receivers)
+    {
+        delete r.core;
+    }
+    delete[] ring;
+    delete[] refs;
+}
+
+double FanoutSenderSocket::getElapsedTime()
+{
+    auto elapsedTime = steady_clock::now() - constructedTime;
+    return duration_cast<duration<double>>(elapsedTime).count();
+}
+
+double FanoutSenderSocket::now()
+{
+    return ClockTimer::now();
+}
+
+int FanoutSenderSocket::slot(DWORD seq)
+{
+    return seq % window;
+}
+
+void FanoutSenderSocket::setFastRetx(bool enabled)
+{
+    fastRetxEnabled = enabled;
+}
+
+void FanoutSenderSocket::setCompressed(bool enabled)
+{
+    compressed = enabled;
+}
+
+int FanoutSenderSocket::Open(char **targetHosts, int count, short port, int senderWindow, LinkProperties *linkProperties)
+{
+    if (connected)
+    {
+        return ALREADY_CONNECTED;
+    }
+
+    window = senderWindow;
+    ring = new Packet[window];
+    refs = new int[window]();
+
+    // locate destinations, each gets a core of its own over the shared ring
+    receivers.resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        FanoutReceiver &r = receivers[i];
+        r.owner = this;
+        r.core = makeSenderEngine<MAX_PKT_SIZE, ClockTimer>(window, fastRetxEnabled, &r, NULL, ring);
+        memset(&r.remote, 0, sizeof(r.remote));
+        r.remote.sin_family = AF_INET;
+        r.remote.sin_port = htons(port);
+
+        DWORD IP = inet_addr(targetHosts[i]);
+        if (IP == INADDR_NONE)
+        {
+            hostent *host = gethostbyname(targetHosts[i]);
+            if (!host)
+            {
+                printf("[%.3f]  --> target %s is invalid\n", getElapsedTime(), targetHosts[i]);
+                return INVALID_NAME;
+            }
+            memcpy((char *)&(r.remote.sin_addr), host->h_addr, host->h_length);
+        }
+        else
+        {
+            r.remote.sin_addr.S_un.S_addr = IP;
+        }
+        r.core->RTO = max(1.0, (double)(2 * linkProperties->RTT));
+        r.core->estRTT = linkProperties->RTT;
+        lookup[addressKey(r.remote)] = i;
+    }
+    maxRetx = receivers[0].core->maxRetx;
+
+    empty = CreateSemaphore(NULL, 0, window, NULL);
+    full = CreateSemaphore(NULL, 0, window, NULL);
+
+    socketReceiveReady = CreateEvent(NULL, false, false, NULL);
+    eventQuit = CreateEvent(NULL, true, false, NULL);
+    eventWorkerDone = CreateEvent(NULL, true, false, NULL);
+    long networkMask = FD_READ;
+    if (WSAEventSelect(sock, socketReceiveReady, networkMask) == SOCKET_ERROR)
+    {
+        printf("WSAEventSelect() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+
+    SenderSynHeader ssh;
+    ssh.sdh.flags.SYN = 1;
+    ssh.sdh.flags.COMPRESSED = compressed;
+    ssh.sdh.seq = 0;
+    memcpy(&ssh.lp, linkProperties, sizeof(LinkProperties));
+
+    // SYN every receiver still pending each round, a round lasts one RTO
+    int pending = count;
+    int attempt = 0;
+    int nfds = (int)(sock + 1);
+    double RTO = receivers[0].core->RTO;
+    while (pending > 0 && attempt < maxRetx)
+    {
+        for (FanoutReceiver &r : receivers)
+        {
+            if (r.alive)
+            {
+                continue;
+            }
+            r.synAt = now();
+            if (sendto(sock, (char *)(&ssh), sizeof(SenderSynHeader), 0, (sockaddr *)&r.remote, sizeof(r.remote)) == SOCKET_ERROR)
+            {
+                printf("[%.3f]  --> failed with %d on sendto()\n", getElapsedTime(), WSAGetLastError());
+                return FAILED_SEND;
+            }
+        }
+
+        double deadline = now() + RTO;
+        while (pending > 0)
+        {
+            double left = deadline - now();
+            if (left <= 0)
+            {
+                break;
+            }
+            timeval timeout;
+            timeout.tv_sec = (long)left;
+            timeout.tv_usec = (long)((left - timeout.tv_sec) * 1e6);
+            fd_set fd;
+            FD_ZERO(&fd);
+            FD_SET(sock, &fd);
+
+            int available = select(nfds, &fd, NULL, NULL, &timeout);
+            if (available == 0)
+            {
+                break;
+            }
+            if (available == SOCKET_ERROR)
+            {
+                printf("[%.3f]  <-- failed with %d on select()\n", getElapsedTime(), WSAGetLastError());
+                exit(EXIT_FAILURE);
+            }
+
+            ReceiverHeader rh;
+            sockaddr_in response;
+            socklen_t respLen = sizeof(response);
+            if (recvfrom(sock, (char *)(&rh), sizeof(ReceiverHeader), 0, (sockaddr *)&response, &respLen) == SOCKET_ERROR)
+            {
+                printf("[%.3f]  <-- failed with %d on recvfrom()\n", getElapsedTime(), WSAGetLastError());
+                return FAILED_RECV;
+            }
+            int index = -1;
+            auto it = lookup.find(addressKey(response));
+            if (it != lookup.end())
+            {
+                index = it->second;
+            }
+            else
+            {
+                // a sharded receiver answers from its shard's port, which is not in lookup yet
+                for (int i = 0; i < count && index < 0; ++i)
+                {
+                    if (!receivers[i].alive && receivers[i].remote.sin_addr.s_addr == response.sin_addr.s_addr)
+                    {
+                        index = i;
+                    }
+                }
+            }
+            if (index < 0 || rh.flags.SYN != 1 || rh.flags.ACK != 1)
+            {
+                continue;
+            }
+            FanoutReceiver &r = receivers[index];
+            if (r.alive)
+            {
+                continue;
+            }
+            if (r.remote.sin_port != response.sin_port)
+            {
+                lookup.erase(addressKey(r.remote));
+                r.remote.sin_port = response.sin_port;
+                lookup[addressKey(r.remote)] = index;
+            }
+            SenderEngine *core = r.core;
+            core->estRTT = now() - r.synAt;
+            core->devRTT = 0;
+            core->RTO = core->estRTT + 4 * max(core->devRTT, 0.01);
+            core->receiverWindow = rh.recvWnd;
+            core->effectiveWindow = min(window, (int)rh.recvWnd);
+            core->lastReleased = core->effectiveWindow;
+            r.alive = true;
+            ++aliveCount;
+            --pending;
+        }
+        ++attempt;
+    }
+
+    if (aliveCount == 0)
+    {
+        return TIMEOUT;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        if (!receivers[i].alive)
+        {
+            printf("[%.3f]  --> %s did not answer, continuing without it\n", getElapsedTime(), targetHosts[i]);
+        }
+    }
+    connected = true;
+
+    // the handshake left this set, the worker must not wake on it to an empty socket
+    if (!ResetEvent(socketReceiveReady))
+    {
+        printf("ResetEvent() for socketReceiveREady failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+
+    stats = thread(&FanoutSenderSocket::StatsRun, this);
+    worker = thread(&FanoutSenderSocket::WorkerRun, this);
+
+    // the ring is shared, each receiver is held to its own window in pump()
+    if (!ReleaseSemaphore(empty, window, NULL))
+    {
+        printf("ReleaseSemaphore() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+    return STATUS_OK;
+}
+
+// send r everything produced that fits in its window
+void FanoutSenderSocket::pump(FanoutReceiver &r)
+{
+    SenderEngine *core = r.core;
+    while (core->nextToSend != (int)produced && (DWORD)core->nextToSend - core->senderBase < (DWORD)core->effectiveWindow)
+    {
+        core->onSendReady();
+    }
+    core->armTimer();
+}
+
+// one receiver is done with [from, to); hand back the slots nobody else holds
+void FanoutSenderSocket::releaseThrough(DWORD from, DWORD to)
+{
+    int freed = 0;
+    for (DWORD seq = from; seq != to; ++seq)
+    {
+        if (--refs[slot(seq)] == 0)
+        {
+            ++freed;
+        }
+    }
+    if (freed > 0 && !ReleaseSemaphore(empty, freed, NULL))
+    {
+        printf("ReleaseSemaphore() failed with %d on recv\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+}
+
+// a receiver that exhausted maxRetx no longer holds up the others
+void FanoutSenderSocket::drop(FanoutReceiver &r)
+{
+    printf("[%.3f]  --> %s dropped after %d retx at base %u\n", getElapsedTime(), inet_ntoa(r.remote.sin_addr),
+           r.core->maxRetx, r.core->senderBase);
+
+    r.alive = false;
+    --aliveCount;
+    releaseThrough(r.releasedBase, produced);
+    r.releasedBase = produced;
+    if (aliveCount == 0)
+    {
+        exceededRetx = true;
+    }
+}
+
+DWORD FanoutSenderSocket::minBase()
+{
+    DWORD base = seqNum;
+    for (const FanoutReceiver &r : receivers)
+    {
+        if (r.alive)
+        {
+            base = min(base, r.core->senderBase);
+        }
+    }
+    return base;
+}
+
+// earliest retx timer across the live cores
+DWORD FanoutSenderSocket::timeoutMs()
+{
+    DWORD timeout = INFINITE;
+    for (const FanoutReceiver &r : receivers)
+    {
+        if (r.alive)
+        {
+            timeout = min(timeout, r.core->timeoutMs());
+        }
+    }
+    return timeout;
+}
+
+void FanoutSenderSocket::onTimeout()
+{
+    for (FanoutReceiver &r : receivers)
+    {
+        if (!r.alive || r.core->timeoutMs() != 0)
+        {
+            continue;
+        }
+        if (r.core->onTimeout())
+        {
+            drop(r);
+            continue;
+        }
+        r.core->armTimer();
+    }
+}
+
+// one more packet in the ring: every live receiver holds a reference until it ACKs it
+void FanoutSenderSocket::onSendReady()
+{
+    refs[slot(produced)] = aliveCount;
+    ++produced;
+    for (FanoutReceiver &r : receivers)
+    {
+        if (r.alive)
+        {
+            r.core->seqNum = produced;
+            pump(r);
+        }
+    }
+}
+
+// drain up to ACK_BATCH ACKs, then hand each receiver's share to its core in one go,
+// so the window is released once per receiver per wake-up instead of once per ACK
+void FanoutSenderSocket::recvPacket()
+{
+    ReceiverHeader acks[ACK_BATCH];
+    int from[ACK_BATCH]; // receivers index of each ACK, -1 once it has been processed
+    int count = 0;
+    bool allFinAcked = false;
+    while (count < ACK_BATCH)
+    {
+        ReceiverHeader &rh = acks[count];
+        sockaddr_in response;
+        socklen_t respLen = sizeof(response);
+        int bytes = recvfrom(sock, (char *)(&rh), sizeof(ReceiverHeader), 0, (sockaddr *)&response, &respLen);
+        if (bytes == SOCKET_ERROR)
+        {
+            // the socket is non-blocking after WSAEventSelect, this just means it is empty
+            if (WSAGetLastError() == WSAEWOULDBLOCK)
+            {
+                break;
+            }
+            printf("recvfrom() failed with %d\n", WSAGetLastError());
+            exit(EXIT_FAILURE);
+        }
+
+        auto it = lookup.find(addressKey(response));
+        if (it == lookup.end())
+        {
+            continue;
+        }
+        FanoutReceiver &r = receivers[it->second];
+        // late SYN-ACKs and anything from a dropped receiver
+        if (!r.alive || rh.flags.SYN == 1)
+        {
+            continue;
+        }
+
+        // check if FIN-ACK is recvd
+        if (rh.flags.FIN == 1 && rh.flags.ACK == 1)
+        {
+            if (r.finAcked)
+            {
+                continue;
+            }
+            r.finAcked = true;
+            r.finWindow = rh.recvWnd;
+            printf("[%.3f]  <-- FIN-ACK %u window %X from %s\n", getElapsedTime(), rh.ackSeq, rh.recvWnd, inet_ntoa(response.sin_addr));
+            allFinAcked = true;
+            for (const FanoutReceiver &other : receivers)
+            {
+                if (other.alive && !other.finAcked)
+                {
+                    allFinAcked = false;
+                }
+            }
+            if (allFinAcked)
+            {
+                break;
+            }
+            continue;
+        }
+        from[count++] = it->second;
+    }
+
+    // a full batch may have left more behind, FD_READ fires again for those
+    ReceiverHeader mine[ACK_BATCH];
+    for (int i = 0; i < count; ++i)
+    {
+        int index = from[i];
+        if (index < 0)
+        {
+            continue;
+        }
+        int n = 0;
+        for (int k = i; k < count; ++k)
+        {
+            if (from[k] == index)
+            {
+                mine[n++] = acks[k];
+                from[k] = -1;
+            }
+        }
+        FanoutReceiver &r = receivers[index];
+        r.core->processAcks(mine, n);
+        if (r.core->exceededRetx)
+        {
+            drop(r);
+            continue;
+        }
+        pump(r);
+    }
+
+    if (allFinAcked)
+    {
+        SetEvent(eventQuit);
+    }
+}
+
+void FanoutSenderSocket::WorkerRun()
+{
+    int kernelBuffer = 20e6; // 20 meg
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)(&kernelBuffer), sizeof(int)) == SOCKET_ERROR)
+    {
+        printf("setcokopt() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+    kernelBuffer = 20e6; // 20 meg
+    if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *)(&kernelBuffer), sizeof(int)) == SOCKET_ERROR)
+    {
+        printf("setcokopt() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+    HANDLE events[] = {socketReceiveReady, full, eventQuit};
+
+    while (aliveCount > 0)
+    {
+        int result = WaitForMultipleObjects(3, events, false, timeoutMs());
+        if (result == WAIT_FAILED || result == WAIT_ABANDONED)
+        {
+            printf("WaitForSingleObject() failed with %d\n", WSAGetLastError());
+            exit(EXIT_FAILURE);
+        }
+        switch (result)
+        {
+        case WAIT_TIMEOUT:
+            onTimeout();
+            break;
+        case WAIT_OBJECT_0:
+            recvPacket();
+            break;
+        case (WAIT_OBJECT_0 + 1):
+            onSendReady();
+            break;
+        case (WAIT_OBJECT_0 + 2):
+            return;
+        default:
+            printf("error encountered\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // every receiver dropped: wake a Send() or Close() waiting on a slot
+    SetEvent(eventWorkerDone);
+}
+
+void FanoutSenderSocket::StatsRun()
+{
+    int payloadSize = MAX_PKT_SIZE - sizeof(SenderDataHeader);
+    lastStatsTime = getElapsedTime();
+    lastStatsBase = 0;
+    while (WaitForSingleObject(eventQuit, 2000) == WAIT_TIMEOUT)
+    {
+        double now = getElapsedTime();
+        double dt = now - lastStatsTime;
+        DWORD b = minBase();
+        DWORD top = 0;
+        int T = 0, F = 0;
+        for (const FanoutReceiver &r : receivers)
+        {
+            top = max(top, r.core->senderBase);
+            T += r.core->timeoutCount;
+            F += r.core->fastRetx;
+        }
+
+        // goodput of the slowest live receiver, the one holding the ring back
+        DWORD deltaAckPkts = (b >= lastStatsBase) ? (b - lastStatsBase) : 0;
+        double goodput = (dt > 0) ? (deltaAckPkts * 8.0 * payloadSize) / (dt * 1e6) : 0.0;
+        totalAckedBytes = (uint64_t)b * payloadSize;
+
+        printf("[%2d] R %d/%zu B %5u..%u ( %4.1f MB) N %5u T %d F %d S %.3f Mbps\n",
+               (int)now,
+               aliveCount,
+               receivers.size(),
+               b,
+               top,
+               totalAckedBytes / 1e6,
+               (DWORD)produced,
+               T,
+               F,
+               goodput);
+
+        lastStatsTime = now;
+        lastStatsBase = b;
+    }
+}
+
+int FanoutSenderSocket::Send(char *buf, int bytes)
+{
+    if (!connected)
+    {
+        return NOT_CONNECTED;
+    }
+    if (bytes < 0 || bytes > MAX_PKT_SIZE - (int)sizeof(SenderDataHeader))
+    {
+        return INVALID_ARGUMENT;
+    }
+    HANDLE events[] = {empty, eventWorkerDone};
+    DWORD result = WaitForMultipleObjects(2, events, false, INFINITE);
+    if (result == WAIT_FAILED || result == WAIT_ABANDONED)
+    {
+        printf("WaitForMultipleObjects() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+    // the last receiver dropping out frees every slot, including the one we waited on
+    if (result == WAIT_OBJECT_0 + 1 || exceededRetx)
+    {
+        return TIMEOUT;
+    }
+
+    // build packet once, every receiver's core sends it from the ring
+    Packet &pkt = ring[slot(seqNum)];
+    memcpy(pkt.pkt, &dataHeader, sizeof(SenderDataHeader));
+    memcpy(pkt.pkt + offsetof(SenderDataHeader, seq), &seqNum, sizeof(DWORD));
+    memcpy(pkt.pkt + sizeof(SenderDataHeader), buf, bytes);
+    pkt.size = bytes + sizeof(SenderDataHeader);
+    ++seqNum;
+
+    if (!ReleaseSemaphore(full, 1, NULL))
+    {
+        printf("ReleaseSemaphore() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+    return STATUS_OK;
+}
+
+int FanoutSenderSocket::Close(double &elapsedTime)
+{
+    if (!connected)
+    {
+        return NOT_CONNECTED;
+    }
+
+    // a slot only comes back once every live receiver ACKed it, so holding all of them means everything
+    // is ACKed; if the worker quits first, every receiver was dropped and the rest never will be
+    HANDLE events[] = {empty, eventWorkerDone};
+    for (int i = 0; i < window; ++i)
+    {
+        DWORD result = WaitForMultipleObjects(2, events, false, INFINITE);
+        if (result == WAIT_FAILED || result == WAIT_ABANDONED)
+        {
+            printf("WaitForMultipleObjects() failed with %d\n", WSAGetLastError());
+            exit(EXIT_FAILURE);
+        }
+        if (result == WAIT_OBJECT_0 + 1)
+        {
+            break;
+        }
+    }
+
+    elapsedTime = (double)clock() / CLOCKS_PER_SEC;
+    if (exceededRetx)
+    {
+        SetEvent(eventQuit);
+        worker.join();
+        stats.join();
+        return TIMEOUT;
+    }
+
+    SenderSynHeader fin;
+    fin.sdh.flags.FIN = 1;
+    fin.sdh.seq = seqNum;
+
+    // FIN every live receiver until each has answered, the worker collects the FIN-ACKs
+    double RTO = 0.0;
+    for (const FanoutReceiver &r : receivers)
+    {
+        if (r.alive)
+        {
+            RTO = max(RTO, r.core->RTO);
+        }
+    }
+    int count = 0;
+    while (WaitForSingleObject(eventQuit, (DWORD)(RTO * 1000)) == WAIT_TIMEOUT && count < maxRetx)
+    {
+        for (const FanoutReceiver &r : receivers)
+        {
+            if (!r.alive || r.finAcked)
+            {
+                continue;
+            }
+            if (sendto(sock, (char *)(&fin), sizeof(SenderSynHeader), 0, (sockaddr *)&r.remote, sizeof(r.remote)) == SOCKET_ERROR)
+            {
+                printf("[%.3f]  --> failed with %d on sendto()\n", getElapsedTime(), WSAGetLastError());
+                return FAILED_SEND;
+            }
+        }
+        ++count;
+    }
+
+    if (count == maxRetx)
+    {
+        return TIMEOUT;
+    }
+
+    worker.join();
+    stats.join();
+    return STATUS_OK;
+}
+
+// the slowest receiver sets the pace
+double FanoutSenderSocket::getEstRTT()
+{
+    double RTT = 0.0;
+    for (const FanoutReceiver &r : receivers)
+    {
+        if (r.alive)
+        {
+            RTT = max(RTT, r.core->estRTT);
+        }
+    }
+    return RTT;
+}
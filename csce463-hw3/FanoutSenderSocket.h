@@ -0,0 +1,97 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include "SenderSocket.h"
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class FanoutSenderSocket;
+
+// one receiver of the fan-out: its own SenderCore sends out of the shared ring,
+// and this is the transport that core talks to
+class FanoutReceiver : public SenderTransport
+{
+public:
+	FanoutSenderSocket *owner = NULL;
+	SenderEngine *core = NULL;
+	sockaddr_in remote;
+	double synAt = 0.0;     // when the last SYN went out, for the first RTT sample
+	DWORD releasedBase = 0; // holds a ring reference on every produced seq from here on
+	bool alive = false;     // set by the SYN-ACK, cleared once maxRetx is exhausted
+	bool finAcked = false;
+	DWORD finWindow = 0; // checksum carried by the FIN-ACK
+
+	void transmit(const char *buf, int bytes);
+	void releaseSlots(int count);
+	void allAcked();
+};
+
+// one Send() loop pushing the same stream to several receivers
+class FanoutSenderSocket : public TransferSocket
+{
+	friend class FanoutReceiver;
+
+private:
+	SOCKET sock;
+	sockaddr_in local;
+	std::chrono::steady_clock::time_point constructedTime;
+	std::thread worker;
+	std::thread stats;
+	std::vector<FanoutReceiver> receivers;
+	std::unordered_map<uint64_t, int> lookup; // (ip << 16) | port to receivers index
+	Packet *ring = NULL; // filled once by Send(), every receiver's core sends from it
+	int *refs = NULL;    // live receivers that have not ACKed each slot yet
+	SenderDataHeader dataHeader; // copied into every packet, only seq changes
+	int window = 0;
+	int maxRetx = 50;
+	DWORD seqNum = 0;   // written by Send()
+	DWORD produced = 0; // packets the worker has picked up
+	int aliveCount = 0;
+	bool exceededRetx = false;
+	bool connected = false;
+	bool fastRetxEnabled = true;
+	bool compressed = false;
+	// semaphores
+	HANDLE empty;
+	HANDLE full;
+	HANDLE socketReceiveReady;
+	HANDLE eventQuit;
+	HANDLE eventWorkerDone; // every receiver dropped, nothing frees a slot after this
+
+	// stats variables
+	uint64_t totalAckedBytes = 0; // by the slowest live receiver
+	double lastStatsTime = 0.0;
+	DWORD lastStatsBase = 0;
+
+	// helpers
+	void closeSocket();
+	double getElapsedTime();
+	double now();
+	int slot(DWORD seq);
+	void pump(FanoutReceiver &r);
+	void releaseThrough(DWORD from, DWORD to);
+	void drop(FanoutReceiver &r);
+	DWORD minBase();
+	DWORD timeoutMs();
+	void onTimeout();
+	void onSendReady();
+	void recvPacket();
+	void WorkerRun();
+	void StatsRun();
+
+public:
+	FanoutSenderSocket();
+	~FanoutSenderSocket();
+	int Open(char **targetHosts, int count, short port, int senderWindow, LinkProperties *linkProperties);
+	int Send(char *buf, int bytes);
+	int Close(double &elapsedTime);
+	double getEstRTT();
+	void setFastRetx(bool enabled);
+	void setCompressed(bool enabled);
+};
@@ -0,0 +1,138 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "PacketTrace.h"
+#include "pch.h"
+
+using std::lock_guard, std::mutex, std::thread, std::vector;
+
+PacketTrace::~PacketTrace()
+{
+    Close();
+}
+
+bool PacketTrace::Create(const char *path)
+{
+    if (fopen_s(&file, path, "wb") != 0)
+    {
+        printf("failed to open trace file %s\n", path);
+        file = NULL;
+        return false;
+    }
+    pending.reserve(TRACE_FLUSH_RECORDS);
+    filled.reserve(TRACE_FLUSH_RECORDS);
+    eventFilled = CreateEvent(NULL, false, false, NULL);
+    eventQuit = CreateEvent(NULL, true, false, NULL);
+    writer = thread(&PacketTrace::WriterRun, this);
+    return true;
+}
+
+void PacketTrace::WriteHeader(const TraceFileHeader &hdr)
+{
+    lock_guard<mutex> guard(lock);
+    if (file)
+    {
+        fwrite(&hdr, sizeof(TraceFileHeader), 1, file);
+    }
+}
+
+// takes each filled batch and writes it with the lock released, so Record() never waits on the disk
+void PacketTrace::WriterRun()
+{
+    HANDLE events[] = {eventFilled, eventQuit};
+    vector<TraceRecord> batch;
+    batch.reserve(TRACE_FLUSH_RECORDS);
+    while (true)
+    {
+        DWORD result = WaitForMultipleObjects(2, events, false, INFINITE);
+        if (result == WAIT_FAILED || result == WAIT_ABANDONED)
+        {
+            printf("WaitForMultipleObjects() failed with %d\n", GetLastError());
+            exit(EXIT_FAILURE);
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            batch.swap(filled);
+        }
+        if (!batch.empty())
+        {
+            fwrite(batch.data(), sizeof(TraceRecord), batch.size(), file);
+            batch.clear();
+        }
+        if (result == WAIT_OBJECT_0 + 1)
+        {
+            return;
+        }
+    }
+}
+
+void PacketTrace::Record(double time, BYTE type, BYTE flags, WORD size, DWORD seq, DWORD recvWnd)
+{
+    TraceRecord r;
+    r.time = time;
+    r.type = type;
+    r.flags = flags;
+    r.size = size;
+    r.seq = seq;
+    r.recvWnd = recvWnd;
+
+    lock_guard<mutex> guard(lock);
+    pending.push_back(r);
+    // while the writer is still busy with the last batch, keep growing this one
+    if (pending.size() >= TRACE_FLUSH_RECORDS && filled.empty() && file)
+    {
+        pending.swap(filled);
+        SetEvent(eventFilled);
+    }
+}
+
+void PacketTrace::Close()
+{
+    if (!file)
+    {
+        return;
+    }
+    SetEvent(eventQuit);
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+    CloseHandle(eventFilled);
+    CloseHandle(eventQuit);
+
+    lock_guard<mutex> guard(lock);
+    if (!pending.empty())
+    {
+        fwrite(pending.data(), sizeof(TraceRecord), pending.size(), file);
+        pending.clear();
+    }
+    fclose(file);
+    file = NULL;
+}
+
+bool PacketTrace::Load(const char *path, TraceFileHeader &hdr, vector<TraceRecord> &records)
+{
+    FILE *f;
+    if (fopen_s(&f, path, "rb") != 0)
+    {
+        printf("failed to open trace file %s\n", path);
+        return false;
+    }
+    if (fread(&hdr, sizeof(TraceFileHeader), 1, f) != 1 || hdr.magic != TRACE_MAGIC)
+    {
+        printf("%s is not a packet trace\n", path);
+        fclose(f);
+        return false;
+    }
+
+    TraceRecord r;
+    while (fread(&r, sizeof(TraceRecord), 1, f) == 1)
+    {
+        records.push_back(r);
+    }
+    fclose(f);
+    return true;
+}
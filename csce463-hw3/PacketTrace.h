@@ -0,0 +1,78 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include "PacketHeaders.h"
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// CONSTANTS
+#define TRACE_MAGIC 0x31435254    // "TRC1"
+#define TRACE_FLUSH_RECORDS 65536 // records buffered before a batch goes to the writer thread
+
+// record types
+#define TRACE_APP 0       // application handed seq to Send()
+#define TRACE_TX 1        // data packet went out (first copy or retx)
+#define TRACE_RX 2        // ReceiverHeader arrived
+#define TRACE_TIMEOUT 3   // retx timer fired on senderBase
+#define TRACE_FAST_RETX 4 // third duplicate ACK resent senderBase
+
+#pragma pack(push, 1)
+class TraceFileHeader
+{
+public:
+	DWORD magic;
+	DWORD window;  // sender window (in pkts)
+	DWORD maxRetx;
+	DWORD recvWnd; // receiver window from the SYN-ACK
+	double estRTT; // estimates right after the handshake
+	double devRTT;
+	double RTO;
+};
+class TraceRecord
+{
+public:
+	double time; // seconds on the sender's clock
+	BYTE type;
+	BYTE flags;  // SYN/ACK/FIN of the header, low three bits
+	WORD size;   // packet bytes for TX, payload bytes for APP
+	DWORD seq;   // seq for APP/TX, ackSeq for RX, senderBase for timers
+	DWORD recvWnd;
+};
+#pragma pack(pop)
+
+// buffered binary trace; Record() may be called from the worker and Send() threads,
+// only the writer thread touches the disk while recording
+class PacketTrace
+{
+private:
+	FILE *file = NULL;
+	std::mutex lock;
+	std::vector<TraceRecord> pending;
+	std::vector<TraceRecord> filled; // handed to the writer, empty while it is free
+	std::thread writer;
+	HANDLE eventFilled = NULL;
+	HANDLE eventQuit = NULL;
+
+	// helpers
+	void WriterRun();
+
+public:
+	~PacketTrace();
+	bool Create(const char *path);
+	void WriteHeader(const TraceFileHeader &hdr);
+	void Record(double time, BYTE type, BYTE flags, WORD size, DWORD seq, DWORD recvWnd);
+	void Close();
+
+	// SYN/ACK/FIN packed into the record's flags byte
+	static BYTE FlagBits(const Flags &f) { return (BYTE)((f.SYN << 2) | (f.ACK << 1) | f.FIN); }
+
+	// reading back a whole trace for replay
+	static bool Load(const char *path, TraceFileHeader &hdr, std::vector<TraceRecord> &records);
+};
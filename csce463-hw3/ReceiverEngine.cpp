@@ -0,0 +1,725 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "ReceiverEngine.h"
+#include "pch.h"
+
+using std::chrono::duration, std::chrono::duration_cast, std::chrono::steady_clock, std::thread;
+
+ReceiverConnection::ReceiverConnection(int recvWindow)
+{
+    window = recvWindow;
+    history = CRC_HISTORY_WINDOWS * window;
+    slotSeq = new DWORD[window];
+    slots = new Packet[window];
+    slotStream = new int[window];
+    slotStreamSeq = new DWORD[window];
+    crcAt = new DWORD[history];
+    bytesAt = new uint64_t[history];
+    memset(slotSeq, 0xFF, window * sizeof(DWORD));
+}
+
+ReceiverConnection::~ReceiverConnection()
+{
+    delete[] slotSeq;
+    delete[] slots;
+    delete[] slotStream;
+    delete[] slotStreamSeq;
+    delete[] crcAt;
+    delete[] bytesAt;
+    delete decoder;
+}
+
+// the sender's checkpoint trails our ACKs by up to a window plus whatever was in flight
+bool ReceiverConnection::canResume(DWORD seq, DWORD crc)
+{
+    if (seq == 0 || seq > nextSeq || nextSeq - seq >= (DWORD)history)
+    {
+        return false;
+    }
+    return crcAt[(seq - 1) % history] == crc;
+}
+
+void ReceiverConnection::rewind(DWORD seq)
+{
+    DWORD slot = (seq - 1) % history;
+    crc.Restore(crcAt[slot]);
+    bytes = bytesAt[slot];
+    nextSeq = seq;
+    finished = false;
+    memset(slotSeq, 0xFF, window * sizeof(DWORD));
+    streams.clear();
+    unacked = 0;
+    outOfOrder = 0;
+}
+
+void ReceiverStream::Deliver(const char *payload, int count)
+{
+    crc.Update((const unsigned char *)payload, count);
+    bytes += count;
+    ++nextSeq;
+}
+
+ReceiverShard::ReceiverShard(int shardId, int recvWindow, SOCKET s, HANDLE quit, int everyN, DWORD delayMs)
+{
+    id = shardId;
+    window = recvWindow;
+    ackEvery = everyN;
+    ackDelayMs = delayMs;
+    started = steady_clock::now();
+    rng.seed(463 + shardId);
+    sock = s;
+    eventQuit = quit;
+
+    socketReady = CreateEvent(NULL, false, false, NULL);
+    queue = new Datagram[SHARD_QUEUE_SIZE];
+    empty = CreateSemaphore(NULL, SHARD_QUEUE_SIZE, SHARD_QUEUE_SIZE, NULL);
+    full = CreateSemaphore(NULL, 0, SHARD_QUEUE_SIZE, NULL);
+}
+
+ReceiverShard::~ReceiverShard()
+{
+    for (auto &c : connections)
+    {
+        delete c.second;
+    }
+    delete[] queue;
+    CloseHandle(socketReady);
+    CloseHandle(empty);
+    CloseHandle(full);
+}
+
+void ReceiverShard::Start()
+{
+    worker = thread(&ReceiverShard::WorkerRun, this);
+}
+
+// eventQuit must be set first, the worker may still be reading the socket until it sees it
+void ReceiverShard::Join()
+{
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+    if (sock != INVALID_SOCKET)
+    {
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+}
+
+// called by the listener thread only; drops the datagram when the shard is backed up
+bool ReceiverShard::Enqueue(const char *buf, int bytes, const sockaddr_in &from)
+{
+    if (WaitForSingleObject(empty, 0) != WAIT_OBJECT_0)
+    {
+        return false;
+    }
+    Datagram *d = queue + queueTail;
+    memcpy(d->pkt, buf, bytes);
+    d->size = bytes;
+    d->from = from;
+    queueTail = (queueTail + 1) % SHARD_QUEUE_SIZE;
+
+    if (!ReleaseSemaphore(full, 1, NULL))
+    {
+        printf("ReleaseSemaphore() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+void ReceiverShard::WorkerRun()
+{
+    if (WSAEventSelect(sock, socketReady, FD_READ) == SOCKET_ERROR)
+    {
+        printf("Shard %d: WSAEventSelect() failed with %d\n", id, WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+
+    HANDLE events[] = {socketReady, full, eventQuit};
+    // held ACKs and the connection sweep need a wake-up even when no data comes in
+    DWORD timeout = (ackEvery > 1) ? ackDelayMs : CONN_SWEEP_MS;
+    Datagram d;
+    while (true)
+    {
+        DWORD result = WaitForMultipleObjects(3, events, false, timeout);
+        if (result == WAIT_FAILED || result == WAIT_ABANDONED)
+        {
+            printf("WaitForMultipleObjects() failed with %d\n", WSAGetLastError());
+            exit(EXIT_FAILURE);
+        }
+        if (result == WAIT_OBJECT_0 + 2)
+        {
+            return;
+        }
+
+        if (result == WAIT_OBJECT_0)
+        {
+            // the socket is non-blocking after WSAEventSelect, read until it is empty
+            while (true)
+            {
+                socklen_t fromLen = sizeof(d.from);
+                d.size = recvfrom(sock, d.pkt, MAX_PKT_SIZE, 0, (sockaddr *)&d.from, &fromLen);
+                if (d.size == SOCKET_ERROR)
+                {
+                    if (WSAGetLastError() == WSAEWOULDBLOCK)
+                    {
+                        break;
+                    }
+                    // ICMP port unreachable from a sender that already went away, or an oversized datagram
+                    if (WSAGetLastError() == WSAECONNRESET || WSAGetLastError() == WSAEMSGSIZE)
+                    {
+                        continue;
+                    }
+                    printf("Shard %d: recvfrom() failed with %d\n", id, WSAGetLastError());
+                    exit(EXIT_FAILURE);
+                }
+                handleDatagram(d);
+                if (ackEvery > 1)
+                {
+                    flushAcks();
+                }
+            }
+        }
+        else if (result == WAIT_OBJECT_0 + 1)
+        {
+            handleDatagram(queue[queueHead]);
+            queueHead = (queueHead + 1) % SHARD_QUEUE_SIZE;
+            ReleaseSemaphore(empty, 1, NULL);
+        }
+
+        flushAcks();
+        expireConnections();
+    }
+}
+
+void ReceiverShard::sendReply(const sockaddr_in &to, int syn, int fin, DWORD recvWnd, DWORD ackSeq)
+{
+    ReceiverHeader rh;
+    rh.flags.SYN = syn;
+    rh.flags.FIN = fin;
+    rh.flags.ACK = 1;
+    rh.recvWnd = recvWnd;
+    rh.ackSeq = ackSeq;
+    if (sendto(sock, (char *)(&rh), sizeof(ReceiverHeader), 0, (sockaddr *)&to, sizeof(to)) == SOCKET_ERROR)
+    {
+        printf("Shard %d: sendto() failed with %d\n", id, WSAGetLastError());
+        return;
+    }
+    ++acks;
+}
+
+// the course receiver drops packets at the rates in the SYN, do the same so a local run sees loss
+bool ReceiverShard::dropped(ReceiverConnection *conn, int path)
+{
+    return conn->pLoss[path] > 0 && std::uniform_real_distribution<float>(0, 1)(rng) < conn->pLoss[path];
+}
+
+double ReceiverShard::now()
+{
+    return duration_cast<duration<double>>(steady_clock::now() - started).count();
+}
+
+// send the held ACKs whose delay ran out; a no-op until the earliest one is due
+void ReceiverShard::flushAcks()
+{
+    double t = now();
+    if (nextAckDue < 0 || t < nextAckDue)
+    {
+        return;
+    }
+    nextAckDue = -1.0;
+    for (auto &c : connections)
+    {
+        ReceiverConnection *conn = c.second;
+        if (conn->unacked == 0)
+        {
+            continue;
+        }
+        if (conn->ackDue <= t)
+        {
+            conn->unacked = 0;
+            if (!dropped(conn, RETURN_PATH))
+            {
+                sendReply(conn->from, 0, 0, window, conn->nextSeq);
+            }
+        }
+        else if (nextAckDue < 0 || conn->ackDue < nextAckDue)
+        {
+            nextAckDue = conn->ackDue;
+        }
+    }
+}
+
+// erase connections that finished or went quiet, so flushAcks() and the map only hold live senders
+void ReceiverShard::expireConnections()
+{
+    double t = now();
+    if (t < nextSweep)
+    {
+        return;
+    }
+    nextSweep = t + CONN_SWEEP_MS / 1e3;
+
+    for (auto it = connections.begin(); it != connections.end();)
+    {
+        ReceiverConnection *conn = it->second;
+        if (t - conn->lastHeard < (conn->finished ? CONN_LINGER_SEC : CONN_IDLE_SEC))
+        {
+            ++it;
+            continue;
+        }
+        if (!conn->finished)
+        {
+            --activeConnections;
+            printf("Shard %d: %s:%d idle for %.0f s, dropped at %.2f MB\n", id, inet_ntoa(conn->from.sin_addr),
+                   ntohs(conn->from.sin_port), CONN_IDLE_SEC, conn->bytes / 1e6);
+        }
+        delete conn;
+        it = connections.erase(it);
+    }
+}
+
+void ReceiverShard::deliver(ReceiverConnection *conn, const char *payload, int bytes)
+{
+    if (conn->decoder)
+    {
+        int rawSize = conn->decoder->Feed(payload, bytes, conn->crc);
+        if (rawSize < 0)
+        {
+            printf("Shard %d: malformed compressed block at byte %llu, checksum will not match\n", id, conn->bytes);
+            delete conn->decoder;
+            conn->decoder = NULL;
+        }
+        else
+        {
+            conn->bytes += rawSize;
+        }
+    }
+    else
+    {
+        conn->crc.Update((const unsigned char *)payload, bytes);
+        conn->bytes += bytes;
+    }
+    deliveredBytes += bytes;
+
+    int slot = conn->nextSeq % conn->history;
+    conn->crcAt[slot] = conn->crc.Value();
+    conn->bytesAt[slot] = conn->bytes;
+}
+
+// a stream packet showed up: hand it to its stream now if that stream has nothing missing before it
+void ReceiverShard::arrive(ReceiverConnection *conn, int stream, DWORD streamSeq, const char *payload, int bytes, DWORD seq)
+{
+    ReceiverStream &st = conn->streams[stream];
+    if (streamSeq < st.nextSeq)
+    {
+        // delivered ahead of the transport already
+        return;
+    }
+    if (streamSeq != st.nextSeq)
+    {
+        st.held[streamSeq] = seq;
+        return;
+    }
+    st.held.erase(streamSeq);
+    st.Deliver(payload, bytes);
+
+    for (auto it = st.held.find(st.nextSeq); it != st.held.end(); it = st.held.find(st.nextSeq))
+    {
+        int slot = it->second % window;
+        if (conn->slotSeq[slot] != it->second)
+        {
+            break;
+        }
+        st.Deliver(conn->slots[slot].pkt, conn->slots[slot].size);
+        st.held.erase(it);
+    }
+}
+
+void ReceiverShard::handleDatagram(Datagram &d)
+{
+    if (d.size < (int)sizeof(SenderDataHeader))
+    {
+        return;
+    }
+    SenderDataHeader sdh;
+    memcpy(&sdh, d.pkt, sizeof(SenderDataHeader));
+    if (sdh.flags.magic != MAGIC_PROTOCOL)
+    {
+        return;
+    }
+    ++packets;
+
+    uint64_t key = ((uint64_t)d.from.sin_addr.s_addr << 16) | d.from.sin_port;
+    auto it = connections.find(key);
+
+    // SYN starts (or restarts) a connection
+    if (sdh.flags.SYN == 1)
+    {
+        bool resumeRequest = d.size >= (int)sizeof(SenderResumeHeader) && sdh.seq > 0;
+        SenderResumeHeader srh;
+        srh.session = 0;
+        if (resumeRequest)
+        {
+            memcpy(&srh, d.pkt, sizeof(SenderResumeHeader));
+        }
+
+        // a retransmitted SYN can sit in the listener queue until after the data started,
+        // so a repeat of the SYN a live connection began with only gets its SYN-ACK again
+        if (it != connections.end() && !it->second->finished && it->second->synSeq == sdh.seq &&
+            it->second->synSession == srh.session)
+        {
+            ReceiverConnection *conn = it->second;
+            conn->lastHeard = now();
+            sendReply(d.from, 1, 0, window, conn->synAck);
+            return;
+        }
+
+        // resume request: continue the existing connection if our data up to seq has the same CRC
+        if (resumeRequest && it != connections.end())
+        {
+            ReceiverConnection *conn = it->second;
+            if (conn->canResume(sdh.seq, srh.crc))
+            {
+                if (conn->finished)
+                {
+                    ++activeConnections;
+                }
+                conn->rewind(sdh.seq);
+                conn->from = d.from;
+                conn->lastHeard = now();
+                conn->synSeq = sdh.seq;
+                conn->synSession = srh.session;
+                conn->synAck = sdh.seq;
+                printf("Shard %d: %s:%d resumed at seq %u, %.2f MB kept\n", id, inet_ntoa(d.from.sin_addr),
+                       ntohs(d.from.sin_port), sdh.seq, conn->bytes / 1e6);
+                sendReply(d.from, 1, 0, window, sdh.seq);
+                return;
+            }
+        }
+
+        if (it != connections.end())
+        {
+            if (!it->second->finished)
+            {
+                --activeConnections;
+            }
+            delete it->second;
+        }
+        // a resume we cannot honor starts over from 0
+        ReceiverConnection *conn = new ReceiverConnection(window);
+        conn->nextSeq = resumeRequest ? 0 : sdh.seq;
+        conn->from = d.from;
+        conn->lastHeard = now();
+        conn->synSeq = sdh.seq;
+        conn->synSession = srh.session;
+        conn->synAck = conn->nextSeq;
+        if (d.size >= (int)sizeof(SenderSynHeader))
+        {
+            SenderSynHeader ssh;
+            memcpy(&ssh, d.pkt, sizeof(SenderSynHeader));
+            conn->pLoss[FORWARD_PATH] = ssh.lp.pLoss[FORWARD_PATH];
+            conn->pLoss[RETURN_PATH] = ssh.lp.pLoss[RETURN_PATH];
+        }
+        if (sdh.flags.COMPRESSED == 1)
+        {
+            conn->decoder = new BlockDecoder();
+        }
+        connections[key] = conn;
+        ++activeConnections;
+        sendReply(d.from, 1, 0, window, conn->nextSeq);
+        return;
+    }
+
+    // no handshake from this sender
+    if (it == connections.end())
+    {
+        return;
+    }
+    ReceiverConnection *conn = it->second;
+    conn->lastHeard = now();
+
+    // FIN-ACK carries the checksum of everything delivered in place of the window
+    if (sdh.flags.FIN == 1)
+    {
+        if (!conn->finished)
+        {
+            conn->finished = true;
+            --activeConnections;
+            printf("Shard %d: %s:%d done, %.2f MB delivered%s, checksum %X\n", id, inet_ntoa(d.from.sin_addr),
+                   ntohs(d.from.sin_port), conn->bytes / 1e6, conn->decoder ? " (decompressed)" : "", conn->crc.Value());
+            for (auto &st : conn->streams)
+            {
+                printf("Shard %d:   stream %d %.2f MB, checksum %X\n", id, st.first, st.second.bytes / 1e6,
+                       st.second.crc.Value());
+            }
+        }
+        conn->unacked = 0;
+        sendReply(d.from, 0, 1, conn->crc.Value(), sdh.seq);
+        return;
+    }
+    if (conn->finished || dropped(conn, FORWARD_PATH))
+    {
+        return;
+    }
+
+    DWORD seq = sdh.seq;
+    int headerSize = sizeof(SenderDataHeader);
+    int stream = -1;
+    DWORD streamSeq = 0;
+    if (sdh.flags.STREAM == 1)
+    {
+        headerSize = sizeof(SenderStreamHeader);
+        if (d.size < headerSize)
+        {
+            return;
+        }
+        SenderStreamHeader ssh;
+        memcpy(&ssh, d.pkt, sizeof(SenderStreamHeader));
+        stream = ssh.streamId;
+        streamSeq = ssh.streamSeq;
+    }
+    const char *payload = d.pkt + headerSize;
+    int bytes = d.size - headerSize;
+    DWORD oldNext = conn->nextSeq;
+
+    if (seq == conn->nextSeq)
+    {
+        deliver(conn, payload, bytes);
+        if (stream >= 0)
+        {
+            arrive(conn, stream, streamSeq, payload, bytes, seq);
+        }
+        ++conn->nextSeq;
+
+        // drain whatever the gap was holding back
+        int slot = conn->nextSeq % window;
+        while (conn->slotSeq[slot] == conn->nextSeq)
+        {
+            deliver(conn, conn->slots[slot].pkt, conn->slots[slot].size);
+            if (conn->slotStream[slot] >= 0)
+            {
+                arrive(conn, conn->slotStream[slot], conn->slotStreamSeq[slot], conn->slots[slot].pkt,
+                       conn->slots[slot].size, conn->nextSeq);
+            }
+            ++conn->nextSeq;
+            --conn->outOfOrder;
+            slot = conn->nextSeq % window;
+        }
+    }
+    else if (seq > conn->nextSeq && seq - conn->nextSeq < (DWORD)window)
+    {
+        int slot = seq % window;
+        if (conn->slotSeq[slot] != seq)
+        {
+            ++conn->outOfOrder;
+        }
+        conn->slotSeq[slot] = seq;
+        conn->slots[slot].size = bytes;
+        memcpy(conn->slots[slot].pkt, payload, bytes);
+        conn->slotStream[slot] = stream;
+        conn->slotStreamSeq[slot] = streamSeq;
+        if (stream >= 0)
+        {
+            arrive(conn, stream, streamSeq, payload, bytes, seq);
+        }
+    }
+
+    // only a clean in-order packet may wait for the stretch ACK; out of order, a duplicate,
+    // a filled gap or a gap still open is acked at once so the sender's dup-ACK count stays honest
+    bool immediate = ackEvery <= 1 || seq != oldNext || conn->nextSeq != oldNext + 1 || conn->outOfOrder > 0;
+    if (immediate || ++conn->unacked >= ackEvery)
+    {
+        conn->unacked = 0;
+        if (!dropped(conn, RETURN_PATH))
+        {
+            sendReply(d.from, 0, 0, window, conn->nextSeq);
+        }
+    }
+    else if (conn->unacked == 1)
+    {
+        conn->ackDue = now() + ackDelayMs / 1e3;
+        if (nextAckDue < 0 || conn->ackDue < nextAckDue)
+        {
+            nextAckDue = conn->ackDue;
+        }
+    }
+}
+
+ReceiverEngine::ReceiverEngine()
+{
+    nShards = 0;
+    shards = NULL;
+    eventQuit = CreateEvent(NULL, true, false, NULL);
+}
+
+ReceiverEngine::~ReceiverEngine()
+{
+    for (int i = 0; i < nShards; ++i)
+    {
+        delete shards[i];
+    }
+    delete[] shards;
+    CloseHandle(eventQuit);
+}
+
+SOCKET ReceiverEngine::openSocket(int port)
+{
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s == INVALID_SOCKET)
+    {
+        printf("socket() generated error %d\n", WSAGetLastError());
+        WSACleanup();
+        exit(EXIT_FAILURE);
+    }
+
+    int kernelBuffer = 20e6; // 20 meg
+    if (setsockopt(s, SOL_SOCKET, SO_RCVBUF, (char *)(&kernelBuffer), sizeof(int)) == SOCKET_ERROR ||
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, (char *)(&kernelBuffer), sizeof(int)) == SOCKET_ERROR)
+    {
+        printf("setsockopt() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+    local.sin_port = htons((u_short)port);
+    if (bind(s, (sockaddr *)&local, sizeof(local)) == SOCKET_ERROR)
+    {
+        printf("bind() to port %d generated error %d\n", port, WSAGetLastError());
+        WSACleanup();
+        exit(EXIT_FAILURE);
+    }
+    return s;
+}
+
+int ReceiverEngine::Start(short port, int shardCount, int recvWindow, int everyN, DWORD delayMs)
+{
+    if (shards)
+    {
+        return ALREADY_CONNECTED;
+    }
+    // both end up as divisors, shard = hash % nShards and slot = seq % window,
+    // and the shard ports go right above the listener
+    int basePort = (u_short)port;
+    if (shardCount < 1 || recvWindow < 1 || everyN < 1 || basePort + shardCount > 65535)
+    {
+        return INVALID_ARGUMENT;
+    }
+    nShards = shardCount;
+    window = recvWindow;
+    ackEvery = everyN;
+    ackDelayMs = max((DWORD)1, delayMs); // a zero wait would spin the shards
+    shards = new ReceiverShard *[nShards];
+
+    // Winsock has no SO_REUSEPORT, so every shard gets its own port instead. Only the SYN
+    // goes through the listener thread, the shard answers from its port and the sender
+    // follows it there, so data and ACKs never pass through a single thread
+    listenSock = openSocket(basePort);
+    for (int i = 0; i < nShards; ++i)
+    {
+        shards[i] = new ReceiverShard(i, window, openSocket(basePort + 1 + i), eventQuit, ackEvery, ackDelayMs);
+    }
+    dispatcher = thread(&ReceiverEngine::DispatchRun, this);
+    printf("Receiver: port %d, %d shards on ports %d-%d, window %d\n", basePort, nShards, basePort + 1,
+           basePort + nShards, window);
+
+    if (ackEvery > 1)
+    {
+        printf("Receiver: ACK every %d packets or after %u ms\n", ackEvery, ackDelayMs);
+    }
+
+    for (int i = 0; i < nShards; ++i)
+    {
+        shards[i]->Start();
+    }
+    stats = thread(&ReceiverEngine::StatsRun, this);
+    return STATUS_OK;
+}
+
+void ReceiverEngine::DispatchRun()
+{
+    char buf[MAX_PKT_SIZE];
+    sockaddr_in from;
+    while (true)
+    {
+        socklen_t fromLen = sizeof(from);
+        int bytes = recvfrom(listenSock, buf, MAX_PKT_SIZE, 0, (sockaddr *)&from, &fromLen);
+        if (bytes == SOCKET_ERROR)
+        {
+            if (WaitForSingleObject(eventQuit, 0) == WAIT_OBJECT_0)
+            {
+                return;
+            }
+            if (WSAGetLastError() == WSAECONNRESET || WSAGetLastError() == WSAEMSGSIZE)
+            {
+                continue;
+            }
+            printf("Listener: recvfrom() failed with %d\n", WSAGetLastError());
+            exit(EXIT_FAILURE);
+        }
+
+        // same sender always lands on the same shard, a resumed or repeated SYN included
+        uint64_t key = ((uint64_t)from.sin_addr.s_addr << 16) | from.sin_port;
+        int shard = (int)(((key * 0x9E3779B97F4A7C15ULL) >> 32) % nShards);
+        shards[shard]->Enqueue(buf, bytes, from);
+    }
+}
+
+void ReceiverEngine::StatsRun()
+{
+    auto start = steady_clock::now();
+    uint64_t *lastBytes = new uint64_t[nShards]();
+    while (WaitForSingleObject(eventQuit, 2000) == WAIT_TIMEOUT)
+    {
+        int now = (int)duration_cast<duration<double>>(steady_clock::now() - start).count();
+        int conns = 0;
+        uint64_t pkts = 0;
+        uint64_t total = 0;
+        double goodput = 0.0;
+        printf("[%2d] shards", now);
+        for (int i = 0; i < nShards; ++i)
+        {
+            uint64_t b = shards[i]->deliveredBytes;
+            double shardRate = (b - lastBytes[i]) * 8 / (2.0 * 1e6);
+            printf(" %.1f", shardRate);
+            goodput += shardRate;
+            lastBytes[i] = b;
+            total += b;
+            pkts += shards[i]->packets;
+            conns += shards[i]->activeConnections;
+        }
+        printf(" Mbps, total %.3f Mbps, C %d P %llu ( %.1f MB)\n", goodput, conns, pkts, total / 1e6);
+    }
+    delete[] lastBytes;
+}
+
+void ReceiverEngine::Stop()
+{
+    SetEvent(eventQuit);
+    // closing the listener unblocks its recvfrom()
+    if (listenSock != INVALID_SOCKET)
+    {
+        closesocket(listenSock);
+        listenSock = INVALID_SOCKET;
+    }
+    if (dispatcher.joinable())
+    {
+        dispatcher.join();
+    }
+    for (int i = 0; i < nShards; ++i)
+    {
+        shards[i]->Join();
+    }
+    if (stats.joinable())
+    {
+        stats.join();
+    }
+}
@@ -0,0 +1,158 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include "SenderSocket.h"
+#include "Compressor.h"
+#include "RunningChecksum.h"
+#include <map>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+// CONSTANTS
+#define RECV_WINDOW 4096      // default advertised receiver window (in pkts)
+#define SHARD_QUEUE_SIZE 4096 // datagrams the listener may queue per shard
+#define ACK_DELAY_MS 5        // longest an in-order ACK is held back when acking every N packets
+#define MAX_SHARDS 64
+#define MAX_RECV_WINDOW (1 << 20) // a connection holds a packet per slot, so this is about 1.5 GB
+#define MAX_ACK_DELAY_MS 1000
+#define CRC_HISTORY_WINDOWS 4 // windows of resume points kept, a sender checkpoint may be this far behind
+#define CONN_LINGER_SEC 10.0  // finished connections stay this long to re-ack a lost FIN or take a resume
+#define CONN_IDLE_SEC 120.0   // unfinished connections silent this long are dropped
+#define CONN_SWEEP_MS 1000    // how often a shard looks for connections to drop
+
+class Datagram
+{
+public:
+	int size;
+	sockaddr_in from;
+	char pkt[MAX_PKT_SIZE];
+};
+
+// one stream of a multiplexed connection, delivered in streamSeq order even
+// while the transport is still waiting on another stream's retransmission
+class ReceiverStream
+{
+public:
+	DWORD nextSeq = 0;
+	uint64_t bytes = 0;
+	RunningChecksum crc;
+	std::map<DWORD, DWORD> held; // streamSeq to transport seq, still in the reorder buffer
+	void Deliver(const char *payload, int bytes);
+};
+
+// per-sender state, owned by exactly one shard
+class ReceiverConnection
+{
+public:
+	DWORD nextSeq = 0; // next expected sequence, doubles as the cumulative ACK
+	uint64_t bytes = 0;
+	bool finished = false;
+	// the SYN that opened or last resumed us, and what its SYN-ACK said
+	DWORD synSeq = 0;
+	DWORD synSession = 0;
+	DWORD synAck = 0;
+	double lastHeard = 0.0; // shard time of the last datagram from this sender
+	sockaddr_in from;
+	// stretch ACKs: in-order packets not acked yet, and when they must be
+	int unacked = 0;
+	double ackDue = 0.0;
+	int outOfOrder = 0; // packets waiting in the reorder buffer
+	float pLoss[2] = {0, 0}; // loss the SYN asked us to emulate, data on FORWARD_PATH, ACKs on RETURN_PATH
+	RunningChecksum crc;
+	BlockDecoder *decoder = NULL; // compressed connections only, crc and bytes then cover the decoded data
+	// reorder buffer keyed by seq, slot seq % window
+	DWORD *slotSeq;
+	Packet *slots;
+	int *slotStream; // -1 unless the packet came with a SenderStreamHeader
+	DWORD *slotStreamSeq;
+	std::unordered_map<int, ReceiverStream> streams;
+	// running CRC and byte count right after each of the last history delivered seqs
+	DWORD *crcAt;
+	uint64_t *bytesAt;
+	int window;
+	int history;
+	ReceiverConnection(int recvWindow);
+	~ReceiverConnection();
+	bool canResume(DWORD seq, DWORD crc);
+	void rewind(DWORD seq);
+};
+
+class ReceiverShard
+{
+private:
+	int id;
+	int window;
+	int ackEvery;
+	DWORD ackDelayMs;
+	double nextAckDue = -1.0; // earliest ackDue of any connection, -1 when none is pending
+	double nextSweep = 0.0;
+	std::chrono::steady_clock::time_point started;
+	std::mt19937 rng;
+	SOCKET sock; // bound to its own port, senders move here after the SYN-ACK
+	HANDLE socketReady;
+	HANDLE eventQuit;
+	std::thread worker;
+	std::unordered_map<uint64_t, ReceiverConnection *> connections;
+
+	// datagrams that reached the listener port instead, mostly SYNs
+	Datagram *queue;
+	HANDLE empty;
+	HANDLE full;
+	int queueHead = 0;
+	int queueTail = 0;
+
+	// helpers
+	void handleDatagram(Datagram &d);
+	void deliver(ReceiverConnection *conn, const char *payload, int bytes);
+	void arrive(ReceiverConnection *conn, int stream, DWORD streamSeq, const char *payload, int bytes, DWORD seq);
+	void sendReply(const sockaddr_in &to, int syn, int fin, DWORD recvWnd, DWORD ackSeq);
+	bool dropped(ReceiverConnection *conn, int path);
+	double now();
+	void flushAcks();
+	void expireConnections();
+	void WorkerRun();
+
+public:
+	// stats variables, written only by this shard's thread
+	uint64_t packets = 0;
+	uint64_t deliveredBytes = 0;
+	uint64_t acks = 0;
+	int activeConnections = 0;
+
+	ReceiverShard(int shardId, int recvWindow, SOCKET s, HANDLE quit, int everyN, DWORD delayMs);
+	~ReceiverShard();
+	void Start();
+	void Join();
+	bool Enqueue(const char *buf, int bytes, const sockaddr_in &from);
+};
+
+class ReceiverEngine
+{
+private:
+	int nShards;
+	int window;
+	int ackEvery;
+	DWORD ackDelayMs;
+	SOCKET listenSock = INVALID_SOCKET;
+	ReceiverShard **shards;
+	std::thread dispatcher;
+	std::thread stats;
+	HANDLE eventQuit;
+
+	// helpers
+	SOCKET openSocket(int port);
+	void DispatchRun();
+	void StatsRun();
+
+public:
+	ReceiverEngine();
+	~ReceiverEngine();
+	int Start(short port, int shardCount, int recvWindow, int everyN, DWORD delayMs);
+	void Stop();
+};
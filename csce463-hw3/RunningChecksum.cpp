@@ -0,0 +1,58 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "RunningChecksum.h"
+#include "pch.h"
+
+// reflected CRC32 table for polynomial 0x04C11DB7, built once at startup
+class CrcTable
+{
+public:
+    DWORD entries[256];
+    CrcTable()
+    {
+        for (DWORD i = 0; i < 256; ++i)
+        {
+            DWORD c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            }
+            entries[i] = c;
+        }
+    }
+};
+static const CrcTable crcTable;
+
+RunningChecksum::RunningChecksum()
+{
+    Reset();
+}
+
+void RunningChecksum::Reset()
+{
+    crc = 0xFFFFFFFF;
+}
+
+void RunningChecksum::Restore(DWORD value)
+{
+    crc = value ^ 0xFFFFFFFF;
+}
+
+void RunningChecksum::Update(const unsigned char *buf, size_t len)
+{
+    DWORD c = crc;
+    for (size_t i = 0; i < len; ++i)
+    {
+        c = crcTable.entries[(c ^ buf[i]) & 0xFF] ^ (c >> 8);
+    }
+    crc = c;
+}
+
+DWORD RunningChecksum::Value() const
+{
+    return crc ^ 0xFFFFFFFF;
+}
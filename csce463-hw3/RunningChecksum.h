@@ -0,0 +1,24 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+
+// CRC32 that can be fed a stream piece by piece; same polynomial as Checksum::CRC32
+class RunningChecksum
+{
+private:
+	DWORD crc;
+
+public:
+	RunningChecksum();
+	void Reset();
+	void Restore(DWORD value); // continue from an earlier Value()
+	void Update(const unsigned char *buf, size_t len);
+	DWORD Value() const;
+};
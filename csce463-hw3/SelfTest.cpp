@@ -0,0 +1,556 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "SelfTest.h"
+#include "pch.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+using std::chrono::duration, std::chrono::duration_cast, std::chrono::steady_clock, std::string, std::vector;
+
+class SelfTestEntry
+{
+public:
+	const char *name;
+	bool (*run)();
+};
+
+int SelfTest::Run(const char *only)
+{
+    SelfTestEntry tests[] = {
+        {"compress", &SelfTest::Compression},
+        {"bench", &SelfTest::Benchmark},
+        {"resume", &SelfTest::KillAndResume},
+        {"urgent", &SelfTest::UrgentUnderLoss},
+        {"scaling", &SelfTest::ReceiverScaling},
+        {"init", &SelfTest::BufferFill},
+    };
+
+    int ran = 0;
+    int failed = 0;
+    for (const SelfTestEntry &t : tests)
+    {
+        if (only && strcmp(only, t.name) != 0)
+        {
+            continue;
+        }
+        printf("SelfTest: %s\n", t.name);
+        bool ok = t.run();
+        printf("SelfTest: %s %s\n", t.name, ok ? "passed" : "FAILED");
+        ++ran;
+        failed += !ok;
+    }
+
+    if (ran == 0)
+    {
+        printf("SelfTest: no test named %s\n", only);
+        return EXIT_FAILURE;
+    }
+    printf("SelfTest: %d of %d passed\n", ran - failed, ran);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// every block method survives Compress/Decompress, and the block stream survives
+// being cut into packet payloads the way main packs it and BlockDecoder sees it
+bool SelfTest::Compression()
+{
+    const int size = 4 * COMPRESS_BLOCK_SIZE + 1000; // short last block
+    std::mt19937 rng(463);
+    const char *names[] = {"counters", "zeros", "text", "random"};
+    vector<char> samples[4];
+    for (vector<char> &s : samples)
+    {
+        s.resize(size);
+    }
+    for (int i = 0; i < size / 4; ++i)
+    {
+        DWORD v = (DWORD)i;
+        memcpy(samples[0].data() + 4 * i, &v, sizeof(DWORD));
+    }
+    memset(samples[1].data(), 0, size);
+    for (int i = 0; i < size;)
+    {
+        i += snprintf(samples[2].data() + i, size - i, "seq %d acked, window %d; ", i / 7, i % 4096);
+    }
+    for (int i = 0; i < size; ++i)
+    {
+        samples[3][i] = (char)rng();
+    }
+
+    bool ok = true;
+    int payloadSize = MAX_PKT_SIZE - sizeof(SenderDataHeader);
+    vector<char> packed(COMPRESS_BOUND(size));
+    vector<char> unpacked(size);
+    for (int k = 0; k < 4; ++k)
+    {
+        const vector<char> &s = samples[k];
+
+        // the bare codec, on lengths around its literal and match limits
+        int lengths[] = {1, 12, 13, 100, 4096, COMPRESS_BLOCK_SIZE};
+        for (int n : lengths)
+        {
+            int comp = BlockCompressor::Compress(s.data(), n, packed.data(), COMPRESS_BOUND(n));
+            int raw = BlockCompressor::Decompress(packed.data(), comp, unpacked.data(), n);
+            if (comp == 0 || raw != n || memcmp(s.data(), unpacked.data(), n) != 0)
+            {
+                printf("SelfTest:   %s: %d bytes did not round trip (compressed %d, decompressed %d)\n", names[k], n, comp, raw);
+                ok = false;
+            }
+        }
+
+        // the whole stage, fed back in payload-sized pieces
+        RunningChecksum expected;
+        expected.Update((const unsigned char *)s.data(), size);
+        CompressionStage stage(s.data(), size, 2);
+        uint64_t streamBytes = 0;
+        char *block;
+        int blockBytes;
+        while (stage.Next(block, blockBytes))
+        {
+            memcpy(packed.data() + streamBytes, block, blockBytes);
+            streamBytes += blockBytes;
+        }
+
+        BlockDecoder decoder;
+        RunningChecksum crc;
+        uint64_t decoded = 0;
+        for (uint64_t off = 0; off < streamBytes; off += payloadSize)
+        {
+            int bytes = (int)min((uint64_t)payloadSize, streamBytes - off);
+            int rawSize = decoder.Feed(packed.data() + off, bytes, crc);
+            if (rawSize < 0)
+            {
+                break;
+            }
+            decoded += rawSize;
+        }
+        bool match = decoded == (uint64_t)size && crc.Value() == expected.Value();
+        printf("SelfTest:   %-8s %d -> %llu bytes, decoded %llu, checksum %X / %X %s\n", names[k], size, streamBytes,
+               decoded, crc.Value(), expected.Value(), match ? "ok" : "MISMATCH");
+        ok = ok && match;
+    }
+    return ok;
+}
+
+static double nsSince(steady_clock::time_point start, int ops)
+{
+    return duration_cast<duration<double>>(steady_clock::now() - start).count() * 1e9 / ops;
+}
+
+// what the power-of-two specialization buys: slot() on its own as a dependent chain,
+// then buildPacket() on a mask core and a modulo core; only fails if the indexes disagree
+bool SelfTest::Benchmark()
+{
+    volatile int windowSource = 4096; // read at run time so the compiler cannot turn % into a mask
+    int window = windowSource;
+    MaskIndex mask(window);
+    ModuloIndex modulo(window);
+
+    bool ok = true;
+    DWORD edges[] = {0, (DWORD)window - 1, (DWORD)window, 0x7FFFFFFF, 0xFFFFFFFF};
+    for (DWORD seq : edges)
+    {
+        ok = ok && mask.slot(seq) == modulo.slot(seq);
+    }
+
+    const int lookups = 20000000;
+    int maskSlot = 0;
+    auto start = steady_clock::now();
+    for (int i = 0; i < lookups; ++i)
+    {
+        maskSlot = mask.slot(maskSlot + i);
+    }
+    double maskNs = nsSince(start, lookups);
+
+    int moduloSlot = 0;
+    start = steady_clock::now();
+    for (int i = 0; i < lookups; ++i)
+    {
+        moduloSlot = modulo.slot(moduloSlot + i);
+    }
+    double moduloNs = nsSince(start, lookups);
+    ok = ok && maskSlot == moduloSlot;
+    printf("SelfTest:   slot() mask %.2f ns, modulo %.2f ns, window %d\n", maskNs, moduloNs, window);
+
+    // no transport needed, buildPacket only fills the ring
+    const int packets = 2000000;
+    int payloadSize = MAX_PKT_SIZE - sizeof(SenderDataHeader);
+    vector<char> payload(payloadSize, 'x');
+    int sizes[] = {16, payloadSize};
+    for (int bytes : sizes)
+    {
+        double ns[2];
+        for (int k = 0; k < 2; ++k)
+        {
+            SenderEngine *core = makeSenderEngine<MAX_PKT_SIZE, ClockTimer>(window - k, true, NULL, NULL);
+            start = steady_clock::now();
+            for (int i = 0; i < packets; ++i)
+            {
+                core->buildPacket(payload.data(), bytes);
+            }
+            ns[k] = nsSince(start, packets);
+            delete core;
+        }
+        printf("SelfTest:   buildPacket(%d bytes) mask %.1f ns, modulo %.1f ns\n", bytes, ns[0], ns[1]);
+    }
+    return ok;
+}
+
+// runs this program again with args, its output going to logPath
+HANDLE SelfTest::spawnSelf(const char *args, const char *logPath)
+{
+    char exe[MAX_PATH];
+    if (GetModuleFileNameA(NULL, exe, MAX_PATH) == 0)
+    {
+        printf("GetModuleFileName() failed with %d\n", GetLastError());
+        return NULL;
+    }
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(sa);
+    sa.lpSecurityDescriptor = NULL;
+    sa.bInheritHandle = true;
+    HANDLE log = CreateFileA(logPath, GENERIC_WRITE, FILE_SHARE_READ, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (log == INVALID_HANDLE_VALUE)
+    {
+        printf("CreateFile() failed with %d\n", GetLastError());
+        return NULL;
+    }
+
+    string cmd = string("\"") + exe + "\" " + args;
+    STARTUPINFOA si;
+    memset(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdOutput = log;
+    si.hStdError = log;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    PROCESS_INFORMATION pi;
+    bool ok = CreateProcessA(NULL, &cmd[0], NULL, NULL, true, 0, NULL, NULL, &si, &pi);
+    CloseHandle(log);
+    if (!ok)
+    {
+        printf("CreateProcess() failed with %d\n", GetLastError());
+        return NULL;
+    }
+    CloseHandle(pi.hThread);
+    return pi.hProcess;
+}
+
+bool SelfTest::readFile(const char *path, string &text)
+{
+    FILE *f;
+    if (fopen_s(&f, path, "rb") != 0)
+    {
+        return false;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        text.append(buf, n);
+    }
+    fclose(f);
+    return true;
+}
+
+// the sender half of KillAndResume: start, kill once a checkpoint exists, start again
+bool SelfTest::killThenResume(const char *args, const char *ckptPath, const char *logPath)
+{
+    HANDLE sender = spawnSelf(args, logPath);
+    if (!sender)
+    {
+        return false;
+    }
+    TransferCheckpoint ckpt;
+    auto start = steady_clock::now();
+    while (!(ckpt.Load(ckptPath) && ckpt.offset > 0) && WaitForSingleObject(sender, 1) == WAIT_TIMEOUT &&
+           steady_clock::now() - start < std::chrono::seconds(60))
+    {
+    }
+    bool exited = WaitForSingleObject(sender, 0) == WAIT_OBJECT_0;
+    TerminateProcess(sender, 1);
+    WaitForSingleObject(sender, INFINITE);
+    CloseHandle(sender);
+    if (exited)
+    {
+        printf("SelfTest:   sender exited before it could be killed\n");
+        return false;
+    }
+    if (!ckpt.Load(ckptPath) || ckpt.offset == 0)
+    {
+        printf("SelfTest:   no checkpoint after 60 s\n");
+        return false;
+    }
+    printf("SelfTest:   killed the sender, checkpoint at byte %llu\n", ckpt.offset);
+
+    sender = spawnSelf(args, logPath);
+    if (!sender)
+    {
+        return false;
+    }
+    if (WaitForSingleObject(sender, 120000) != WAIT_OBJECT_0)
+    {
+        printf("SelfTest:   resumed sender did not finish\n");
+        TerminateProcess(sender, 1);
+        CloseHandle(sender);
+        return false;
+    }
+    DWORD exitCode;
+    GetExitCodeProcess(sender, &exitCode);
+    CloseHandle(sender);
+
+    // the receiver's FIN-ACK carries its checksum of what it kept plus the rest
+    string log;
+    readFile(logPath, log);
+    unsigned long long resumedAt = 0;
+    DWORD finCrc = 0;
+    DWORD ourCrc = 0;
+    size_t at = log.find("verified the first ");
+    if (at != string::npos)
+    {
+        sscanf_s(log.c_str() + at, "verified the first %llu", &resumedAt);
+    }
+    at = log.find("window ", log.find("FIN-ACK"));
+    if (at != string::npos)
+    {
+        sscanf_s(log.c_str() + at, "window %X", &finCrc);
+    }
+    at = log.find("checksum ", log.find("transfer finished"));
+    if (at != string::npos)
+    {
+        sscanf_s(log.c_str() + at, "checksum %X", &ourCrc);
+    }
+    printf("SelfTest:   resumed at byte %llu, exit code %u, checksum %X / %X\n", resumedAt, exitCode, finCrc, ourCrc);
+    return exitCode == 0 && resumedAt > 0 && finCrc != 0 && finCrc == ourCrc;
+}
+
+// a sender killed mid-transfer picks up past byte 0 on the next run: the receiver runs in
+// this process, this program is started twice as the sender with the same checkpoint file
+bool SelfTest::KillAndResume()
+{
+    const char *ckptPath = "selftest-resume.ckp";
+    const char *logPath = "selftest-resume.log";
+    // 2^26 DWORDs is 256 MB, long enough on loopback to be caught in the middle
+    const char *args = "127.0.0.1 26 1024 0.01 0 0 1000 -c selftest-resume.ckp";
+    remove(ckptPath);
+
+    ReceiverEngine receiver;
+    if (receiver.Start(MAGIC_PORT, 1, RECV_WINDOW, 1, ACK_DELAY_MS) != STATUS_OK)
+    {
+        return false;
+    }
+    bool ok = killThenResume(args, ckptPath, logPath);
+    receiver.Stop();
+    remove(ckptPath);
+    return ok;
+}
+
+// a strict message finds a window slot while bulk on the same connection is stuck behind a loss:
+// the receiver in this process drops 1% of the data, the sender sends an urgent message every
+// 20 ms, and none of them may sit out a retransmission timeout (40 ms at the least) for a slot
+bool SelfTest::UrgentUnderLoss()
+{
+    const char *logPath = "selftest-urgent.log";
+    const char *args = "127.0.0.1 24 64 0.01 0.01 0 1000 -u 20";
+    const double limitMs = 10.0;
+
+    ReceiverEngine receiver;
+    if (receiver.Start(MAGIC_PORT, 1, RECV_WINDOW, 1, ACK_DELAY_MS) != STATUS_OK)
+    {
+        return false;
+    }
+    HANDLE sender = spawnSelf(args, logPath);
+    bool finished = sender && WaitForSingleObject(sender, 120000) == WAIT_OBJECT_0;
+    DWORD exitCode = 1;
+    if (sender)
+    {
+        if (!finished)
+        {
+            printf("SelfTest:   sender did not finish\n");
+            TerminateProcess(sender, 1);
+        }
+        GetExitCodeProcess(sender, &exitCode);
+        CloseHandle(sender);
+    }
+    receiver.Stop();
+
+    string log;
+    readFile(logPath, log);
+    double waitMs[2] = {-1.0, -1.0};
+    double megabytes[2] = {0.0, 0.0};
+    const char *modes[] = {"(strict)", "(weighted)"};
+    for (int k = 0; k < 2; ++k)
+    {
+        size_t at = log.find(modes[k]);
+        if (at == string::npos)
+        {
+            continue;
+        }
+        sscanf_s(log.c_str() + at + strlen(modes[k]), " %lf MB", &megabytes[k]);
+        at = log.find("slot wait max ", at);
+        if (at != string::npos)
+        {
+            sscanf_s(log.c_str() + at, "slot wait max %lf", &waitMs[k]);
+        }
+    }
+    printf("SelfTest:   urgent %.3f MB waited at most %.1f ms for a slot, bulk %.2f MB at most %.1f ms, exit code %u\n",
+           megabytes[0], waitMs[0], megabytes[1], waitMs[1], exitCode);
+    return finished && exitCode == 0 && megabytes[0] > 0 && waitMs[0] >= 0 && waitMs[0] < limitMs;
+}
+
+// count senders in this process push bytes each to the receiver on MAGIC_PORT at the same
+// time; returns their aggregate goodput in Mbps, or -1 if any of them failed
+double SelfTest::loopbackSenders(int count, const char *buf, int bytes)
+{
+    std::atomic<int> failed{0};
+    vector<std::thread> senders;
+    auto start = steady_clock::now();
+    for (int i = 0; i < count; ++i)
+    {
+        senders.emplace_back([&failed, buf, bytes]() {
+            SenderSocket ss;
+            LinkProperties lp;
+            lp.RTT = 0.001f;
+            lp.speed = 1e9f;
+            lp.bufferSize = 1024 + 5;
+            char host[] = "127.0.0.1";
+            if (ss.Open(host, MAGIC_PORT, 1024, &lp) != STATUS_OK)
+            {
+                ++failed;
+                return;
+            }
+            int payloadSize = MAX_PKT_SIZE - sizeof(SenderDataHeader);
+            for (int off = 0; off < bytes; off += payloadSize)
+            {
+                if (ss.Send((char *)buf + off, min(payloadSize, bytes - off)) != STATUS_OK)
+                {
+                    ++failed;
+                    return;
+                }
+            }
+            double elapsed;
+            if (ss.Close(elapsed) != STATUS_OK)
+            {
+                ++failed;
+            }
+        });
+    }
+    for (std::thread &t : senders)
+    {
+        t.join();
+    }
+    double seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    return failed ? -1.0 : (double)count * bytes * 8 / 1e6 / seconds;
+}
+
+// the same loopback senders against one receiver shard and then one shard per core; the
+// numbers are only reported, how far they scale depends on the machine, not on correctness
+bool SelfTest::ReceiverScaling()
+{
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    int cores = max(1, min((int)sysInfo.dwNumberOfProcessors, MAX_SHARDS));
+    int senders = max(4, min(cores, 16));
+    const int bytes = 16 << 20;
+    vector<char> buf(bytes);
+    for (int i = 0; i < bytes; ++i)
+    {
+        buf[i] = (char)(i * 7 + i / 1000);
+    }
+
+    int shardCounts[] = {1, min(cores, senders)};
+    double rate[2];
+    for (int k = 0; k < 2; ++k)
+    {
+        ReceiverEngine receiver;
+        if (receiver.Start(MAGIC_PORT, shardCounts[k], RECV_WINDOW, 1, ACK_DELAY_MS) != STATUS_OK)
+        {
+            return false;
+        }
+        rate[k] = loopbackSenders(senders, buf.data(), bytes);
+        receiver.Stop();
+        if (rate[k] < 0)
+        {
+            printf("SelfTest:   a sender failed against %d shards\n", shardCounts[k]);
+            return false;
+        }
+    }
+    for (int k = 0; k < 2; ++k)
+    {
+        printf("SelfTest:   %d senders, %2d shards: %.0f Mbps aggregate\n", senders, shardCounts[k], rate[k]);
+    }
+    printf("SelfTest:   %.2fx with %d shards\n", rate[1] / rate[0], shardCounts[1]);
+    return true;
+}
+
+// the streaming fill writes what the serial (DWORD)i loop wrote: Fill() on its own around the
+// 16-DWORD unrolled step, then whole buffers from one element up to several chunks, on 1 to 8 threads
+bool SelfTest::BufferFill()
+{
+    bool ok = true;
+    const int most = 1000;
+    alignas(16) DWORD dst[most + 1]; // Fill() needs 16-byte alignment
+    uint64_t firsts[] = {0, 5, 0xFFFFFFF0ULL}; // the last one wraps the way (DWORD)i does
+    for (uint64_t first : firsts)
+    {
+        for (int n = 0; n <= most; n = (n < 40) ? n + 1 : n * 2 + 3)
+        {
+            dst[n] = 0xDEADBEEF;
+            BufferInit::Fill(dst, first, n);
+            for (int i = 0; i < n; ++i)
+            {
+                if (dst[i] != (DWORD)(first + i))
+                {
+                    printf("SelfTest:   Fill(%llu, %d) wrote %u at %d\n", first, n, dst[i], i);
+                    ok = false;
+                    break;
+                }
+            }
+            if (dst[n] != 0xDEADBEEF)
+            {
+                printf("SelfTest:   Fill(%llu, %d) wrote past the end\n", first, n);
+                ok = false;
+            }
+        }
+    }
+
+    // 2^22 DWORDs is 4 chunks, 2^23 + a thread count that does not divide it leaves uneven work
+    int powers[] = {0, 1, 2, 3, 4, 5, 10, 19, 20, 21, 22, 23};
+    int threads[] = {1, 3, 8};
+    for (int power : powers)
+    {
+        for (int t : threads)
+        {
+            BufferInit init(power, t);
+            init.Start();
+            uint64_t bytes = (uint64_t)4 << power;
+            uint64_t ready = init.WaitUntil(bytes);
+            init.Join();
+            DWORD *buf = init.getBuffer();
+            uint64_t count = (uint64_t)1 << power;
+            uint64_t bad = count;
+            for (uint64_t i = 0; i < count && bad == count; ++i)
+            {
+                if (buf[i] != (DWORD)i)
+                {
+                    bad = i;
+                }
+            }
+            if (bad != count || ready != bytes)
+            {
+                printf("SelfTest:   power %d on %d threads: %s at %llu, %llu of %llu bytes ready\n", power, t,
+                       bad != count ? "wrong value" : "short", bad, ready, bytes);
+                ok = false;
+            }
+        }
+    }
+    printf("SelfTest:   Fill() and %d buffer sizes on 1, 3 and 8 threads %s\n", (int)(sizeof(powers) / sizeof(int)),
+           ok ? "match the serial fill" : "MISMATCH");
+    return ok;
+}
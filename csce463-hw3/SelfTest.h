@@ -0,0 +1,33 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include <windows.h>
+#include <string>
+
+// checks for the pieces a normal transfer cannot verify on its own;
+// -s runs all of them, -s <name> just one, the exit code says if they passed
+class SelfTest
+{
+private:
+	// tests
+	static bool Compression();
+	static bool Benchmark();
+	static bool KillAndResume();
+	static bool UrgentUnderLoss();
+	static bool ReceiverScaling();
+	static bool BufferFill();
+
+	// helpers
+	static HANDLE spawnSelf(const char *args, const char *logPath);
+	static bool killThenResume(const char *args, const char *ckptPath, const char *logPath);
+	static bool readFile(const char *path, std::string &text);
+	static double loopbackSenders(int count, const char *buf, int bytes);
+
+public:
+	static int Run(const char *only);
+};
@@ -0,0 +1,417 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include <windows.h>
+#include "PacketHeaders.h"
+#include "PacketTrace.h"
+#include "RunningChecksum.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+
+template <int Size>
+class SegmentPacket
+{
+public:
+	// int type; // SYN, FIN, data
+	int size; // bytes in packet data
+	char pkt[Size]; // packet with header
+};
+
+// ring slot of a window, seq % window
+class ModuloIndex
+{
+public:
+	int window;
+	ModuloIndex(int senderWindow) : window(senderWindow) {}
+	int slot(DWORD seq) const { return seq % window; }
+};
+
+// ring slot of a power-of-two window, no division
+class MaskIndex
+{
+public:
+	DWORD mask;
+	MaskIndex(int senderWindow) : mask(senderWindow - 1) {}
+	int slot(DWORD seq) const { return seq & mask; }
+};
+
+// sender clock in seconds
+class ClockTimer
+{
+public:
+	static double now() { return (double)clock() / CLOCKS_PER_SEC; }
+};
+
+// clock advanced by hand, used by TraceReplay
+class VirtualTimer
+{
+public:
+	inline static double time = 0.0;
+	static double now() { return time; }
+};
+
+// retransmit base on the third duplicate ACK as well as on timeouts
+class FastRetxRecovery
+{
+public:
+	static const int dupThreshold = 3;
+};
+
+// retransmit base only when the timer fires
+class TimeoutOnlyRecovery
+{
+public:
+	static const int dupThreshold = 0;
+};
+
+// what the core needs from whoever owns the socket and semaphores
+class SenderTransport
+{
+public:
+	virtual void transmit(const char *buf, int bytes) = 0;
+	virtual void releaseSlots(int count) = 0;
+	virtual void allAcked() = 0;
+};
+
+// window and RTO state, visible to the facade for Open/Close and stats
+class SenderState
+{
+public:
+	double RTO;
+	double estRTT;
+	double devRTT = 0.0;
+	double timerExpire = 0.0;
+	bool recomputeTimerExpire = false;
+	int baseRetxCount = 0;
+	int window;
+	DWORD senderBase = 0;
+	int seqNum = 0;
+	int nextToSend = 0;
+	int maxRetx = 50;
+	bool exceededRetx = false;
+	int dupACK = 0;
+	int effectiveWindow = 0;
+	int lastReleased = 0;
+	int newReleased = 0;
+	int payloadSize; // data bytes per full segment
+
+	// stats variables
+	uint64_t totalAckedBytes = 0;
+	int timeoutCount = 0;
+	int fastRetx = 0;
+	DWORD receiverWindow = 0;
+
+	// ACKed prefix for checkpoints, only kept up when trackAcked is set
+	bool trackAcked = false;
+	DWORD ackedSeq = 0;
+	uint64_t ackedOffset = 0;
+	RunningChecksum ackedCrc;
+	std::mutex ackedLock;
+
+	// continue a transfer at seq instead of 0
+	void startAt(DWORD seq, uint64_t offset, DWORD crc)
+	{
+		senderBase = seq;
+		nextToSend = seq;
+		seqNum = seq;
+		ackedSeq = seq;
+		ackedOffset = offset;
+		ackedCrc.Restore(crc);
+	}
+
+	// consistent snapshot for the stats thread
+	void getAcked(DWORD &seq, uint64_t &offset, DWORD &crc)
+	{
+		std::lock_guard<std::mutex> guard(ackedLock);
+		seq = ackedSeq;
+		offset = ackedOffset;
+		crc = ackedCrc.Value();
+	}
+};
+
+// runtime-dispatch interface over the specialized cores
+class SenderEngine : public SenderState
+{
+public:
+	virtual ~SenderEngine() {}
+	virtual double now() = 0;
+	virtual DWORD timeoutMs() = 0;
+	virtual void armTimer() = 0;
+	virtual void buildPacket(const char *buf, int bytes) = 0;
+	virtual void buildStreamPacket(const char *buf, int bytes, WORD stream, DWORD streamSeq) = 0;
+	virtual bool onTimeout() = 0;
+	virtual void onSendReady() = 0;
+	virtual void processAcks(const ReceiverHeader *acks, int count) = 0;
+
+	void processAck(const ReceiverHeader &rh)
+	{
+		processAcks(&rh, 1);
+	}
+};
+
+template <int SegmentSize, class Index, class Timer, class Recovery>
+class SenderCore : public SenderEngine
+{
+private:
+	SegmentPacket<SegmentSize> *buffer; // may be a ring shared with other cores, see FanoutSenderSocket
+	bool ownsBuffer;
+	double *sentAt; // transmission time (in sec) per slot, ours alone even when the ring is shared
+	Index index;
+	SenderTransport *io;
+	PacketTrace *trace;
+	// built once per connection, each packet copies one and fills in its seq
+	SenderDataHeader dataHeader;
+	SenderStreamHeader streamHeader;
+
+	void updateRTO(double RTT)
+	{
+		double alpha = 0.125, beta = 0.25;
+		estRTT = (1 - alpha) * estRTT + alpha * RTT;
+		devRTT = (1 - beta) * devRTT + beta * fabs(RTT - estRTT);
+
+		RTO = estRTT + 4 * max(devRTT, 0.01);
+	}
+
+	void sendPacket(const SegmentPacket<SegmentSize> *pkt)
+	{
+		if (trace)
+		{
+			SenderDataHeader sdh;
+			memcpy(&sdh, pkt->pkt, sizeof(SenderDataHeader));
+			trace->Record(now(), TRACE_TX, PacketTrace::FlagBits(sdh.flags), (WORD)pkt->size, sdh.seq, 0);
+		}
+		io->transmit(pkt->pkt, pkt->size);
+	}
+
+public:
+	SenderCore(int senderWindow, SenderTransport *transport, PacketTrace *packetTrace, SegmentPacket<SegmentSize> *shared)
+		: index(senderWindow)
+	{
+		window = senderWindow;
+		payloadSize = SegmentSize - sizeof(SenderDataHeader);
+		ownsBuffer = shared == NULL;
+		buffer = ownsBuffer ? new SegmentPacket<SegmentSize>[window] : shared;
+		sentAt = new double[window];
+		io = transport;
+		trace = packetTrace;
+		streamHeader.sdh.flags.STREAM = 1;
+	}
+
+	~SenderCore()
+	{
+		if (ownsBuffer)
+		{
+			delete[] buffer;
+		}
+		delete[] sentAt;
+	}
+
+	double now()
+	{
+		return Timer::now();
+	}
+
+	DWORD timeoutMs()
+	{
+		if (senderBase == nextToSend)
+		{
+			return INFINITE;
+		}
+		// an already expired timer must fire now, not wrap around to a huge wait
+		return (DWORD)(max(0.0, timerExpire - Timer::now()) * 1000);
+	}
+
+	void armTimer()
+	{
+		if (recomputeTimerExpire)
+		{
+			timerExpire = Timer::now() + RTO;
+		}
+		recomputeTimerExpire = false;
+	}
+
+	void buildPacket(const char *buf, int bytes)
+	{
+		SegmentPacket<SegmentSize> *pkt = buffer + index.slot(seqNum);
+		memcpy(pkt->pkt, &dataHeader, sizeof(SenderDataHeader));
+		memcpy(pkt->pkt + offsetof(SenderDataHeader, seq), &seqNum, sizeof(DWORD));
+		memcpy(pkt->pkt + sizeof(SenderDataHeader), buf, bytes);
+		pkt->size = bytes + sizeof(SenderDataHeader);
+
+		if (trace)
+		{
+			trace->Record(now(), TRACE_APP, 0, (WORD)bytes, seqNum, 0);
+		}
+		++seqNum;
+	}
+
+	void buildStreamPacket(const char *buf, int bytes, WORD stream, DWORD streamSeq)
+	{
+		SegmentPacket<SegmentSize> *pkt = buffer + index.slot(seqNum);
+		memcpy(pkt->pkt, &streamHeader, sizeof(SenderStreamHeader));
+		memcpy(pkt->pkt + offsetof(SenderDataHeader, seq), &seqNum, sizeof(DWORD));
+		memcpy(pkt->pkt + offsetof(SenderStreamHeader, streamId), &stream, sizeof(WORD));
+		memcpy(pkt->pkt + offsetof(SenderStreamHeader, streamSeq), &streamSeq, sizeof(DWORD));
+		memcpy(pkt->pkt + sizeof(SenderStreamHeader), buf, bytes);
+		pkt->size = bytes + sizeof(SenderStreamHeader);
+
+		if (trace)
+		{
+			trace->Record(now(), TRACE_APP, 0, (WORD)bytes, seqNum, 0);
+		}
+		++seqNum;
+	}
+
+	// retx timer fired: resend base, returns true once maxRetx is exhausted
+	bool onTimeout()
+	{
+		if (trace)
+		{
+			trace->Record(now(), TRACE_TIMEOUT, 0, 0, senderBase, 0);
+		}
+		recomputeTimerExpire = true;
+		// resendbase
+		sendPacket(buffer + index.slot(senderBase));
+		++baseRetxCount;
+		++timeoutCount;
+		if (baseRetxCount == maxRetx)
+		{
+			exceededRetx = true;
+			return true;
+		}
+		return false;
+	}
+
+	void onSendReady()
+	{
+		int slot = index.slot(nextToSend);
+		sentAt[slot] = Timer::now();
+		sendPacket(buffer + slot);
+
+		if (nextToSend == senderBase)
+		{
+			recomputeTimerExpire = true;
+		}
+
+		++nextToSend;
+	}
+
+	// every ACK that was waiting when the worker woke up: each one moves senderBase and
+	// feeds the RTT and dup-ACK logic, the slots go back to Send() once for the whole batch
+	void processAcks(const ReceiverHeader *acks, int count)
+	{
+		DWORD oldBase = senderBase;
+		for (int i = 0; i < count && !exceededRetx; ++i)
+		{
+			const ReceiverHeader &rh = acks[i];
+			if (trace)
+			{
+				trace->Record(now(), TRACE_RX, PacketTrace::FlagBits(rh.flags), 0, rh.ackSeq, rh.recvWnd);
+			}
+
+			DWORD ack = rh.ackSeq;
+			bool windowUpdate = rh.recvWnd != receiverWindow;
+			receiverWindow = rh.recvWnd;
+
+			if (ack > senderBase)
+			{
+				if (baseRetxCount == 0)
+				{
+					double RTT = Timer::now() - sentAt[index.slot(ack - 1)];
+					updateRTO(RTT);
+				}
+
+				dupACK = 0;
+				baseRetxCount = 0;
+				recomputeTimerExpire = true;
+				senderBase = ack;
+			}
+			// this part is for triple duplicate ack; with stretch ACKs the receiver still acks
+			// every out-of-order packet at once, so only a repeat that neither opens the
+			// window nor arrives with nothing in flight counts as a dup
+			else if (Recovery::dupThreshold > 0 && ack == senderBase && senderBase != nextToSend && !windowUpdate)
+			{
+				// check counter and resend once it equals the threshold
+				// same thing as timeout and reset variables
+				++dupACK;
+				if (dupACK == Recovery::dupThreshold)
+				{
+					if (trace)
+					{
+						trace->Record(now(), TRACE_FAST_RETX, 0, 0, senderBase, 0);
+					}
+					sendPacket(buffer + index.slot(senderBase));
+					recomputeTimerExpire = true;
+					++baseRetxCount;
+					++fastRetx;
+					if (baseRetxCount == maxRetx)
+					{
+						exceededRetx = true;
+					}
+				}
+			}
+		}
+
+		if (senderBase == oldBase)
+		{
+			return;
+		}
+
+		totalAckedBytes += (uint64_t)(senderBase - oldBase) * payloadSize;
+
+		// fold the newly ACKed payload in before its slots are handed back to Send()
+		if (trackAcked)
+		{
+			std::lock_guard<std::mutex> guard(ackedLock);
+			for (DWORD seq = oldBase; seq != senderBase; ++seq)
+			{
+				const SegmentPacket<SegmentSize> *pkt = buffer + index.slot(seq);
+				int bytes = pkt->size - sizeof(SenderDataHeader);
+				ackedCrc.Update((const unsigned char *)pkt->pkt + sizeof(SenderDataHeader), bytes);
+				ackedOffset += bytes;
+			}
+			ackedSeq = senderBase;
+		}
+
+		effectiveWindow = min(window, (int)receiverWindow);
+		newReleased = senderBase + effectiveWindow - lastReleased;
+		lastReleased += newReleased;
+
+		io->releaseSlots(newReleased);
+		// only after senderBase moved, so Close() sees it as soon as the event fires
+		if (senderBase == seqNum)
+		{
+			io->allAcked();
+		}
+	}
+};
+
+// picks the specialization for a window: power-of-two windows get the mask index;
+// with shared, the core sends out of that ring (window slots, filled by the caller) instead of its own
+template <int SegmentSize, class Timer>
+SenderEngine *makeSenderEngine(int window, bool fastRetx, SenderTransport *io, PacketTrace *trace,
+							   SegmentPacket<SegmentSize> *shared = NULL)
+{
+	bool pow2 = window > 0 && (window & (window - 1)) == 0;
+	if (pow2 && fastRetx)
+	{
+		return new SenderCore<SegmentSize, MaskIndex, Timer, FastRetxRecovery>(window, io, trace, shared);
+	}
+	if (pow2)
+	{
+		return new SenderCore<SegmentSize, MaskIndex, Timer, TimeoutOnlyRecovery>(window, io, trace, shared);
+	}
+	if (fastRetx)
+	{
+		return new SenderCore<SegmentSize, ModuloIndex, Timer, FastRetxRecovery>(window, io, trace, shared);
+	}
+	return new SenderCore<SegmentSize, ModuloIndex, Timer, TimeoutOnlyRecovery>(window, io, trace, shared);
+}
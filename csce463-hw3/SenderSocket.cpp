@@ -10,7 +10,7 @@
 using std::chrono::duration, std::chrono::duration_cast, std::chrono::high_resolution_clock,
     std::chrono::milliseconds, std::chrono::steady_clock, std::mutex, std::lock_guard, std::thread;
 
-SenderSocket::SenderSocket()
+SenderSocket::SenderSocket(WORD bindPort)
 {
     // open UDP socket and bind
     sock = socket(AF_INET, SOCK_DGRAM, 0);
@@ -24,14 +24,22 @@ SenderSocket::SenderSocket()
     memset(&local, 0, sizeof(local));
     local.sin_family = AF_INET;
     local.sin_addr.s_addr = INADDR_ANY;
-    local.sin_port = htons(0);
+    local.sin_port = htons(bindPort);
     // bind UDP socket
     if (bind(sock, (sockaddr *)&local, sizeof(local)) == SOCKET_ERROR)
     {
-        printf("bind() generated error %d\n", WSAGetLastError());
-        WSACleanup();
-        exit(EXIT_FAILURE);
+        // a port we asked for may be taken by now; any port still works, just without resume
+        local.sin_port = htons(0);
+        if (bindPort == 0 || bind(sock, (sockaddr *)&local, sizeof(local)) == SOCKET_ERROR)
+        {
+            printf("bind() generated error %d\n", WSAGetLastError());
+            WSACleanup();
+            exit(EXIT_FAILURE);
+        }
     }
+    socklen_t localLen = sizeof(local);
+    getsockname(sock, (sockaddr *)&local, &localLen);
+    localPort = ntohs(local.sin_port);
 
     // setup remote
     memset(&remote, 0, sizeof(remote));
@@ -50,8 +58,23 @@ void SenderSocket::closeSocket()
 
 SenderSocket::~SenderSocket()
 {
+    // a Send() or Close() that failed leaves the threads running
+    if (worker.joinable() || stats.joinable())
+    {
+        SetEvent(eventQuit);
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        if (stats.joinable())
+        {
+            stats.join();
+        }
+    }
     closeSocket();
-    delete[] buffer;
+    delete engine;
+    delete streams;
+    delete[] streamTags;
 }
 
 double SenderSocket::getElapsedTime()
@@ -60,29 +83,94 @@ double SenderSocket::getElapsedTime()
     return duration_cast<duration<double>>(elapsedTime).count();
 }
 
-void SenderSocket::updateRTO(double RTT)
+void SenderSocket::setTrace(PacketTrace *packetTrace)
+{
+    trace = packetTrace;
+}
+
+void SenderSocket::setFastRetx(bool enabled)
+{
+    fastRetxEnabled = enabled;
+}
+
+// payload is CompressionStage blocks; the SYN tells the receiver to decode them before its checksum
+void SenderSocket::setCompressed(bool enabled)
+{
+    compressed = enabled;
+}
+
+// progress goes to path every stats interval; with resumeFrom, Open asks the receiver to continue there
+void SenderSocket::setCheckpoint(const char *path, const TransferCheckpoint *resumeFrom)
+{
+    checkpointPath = path;
+    resuming = resumeFrom != NULL;
+    if (resuming)
+    {
+        resume = *resumeFrom;
+    }
+}
+
+// before Open(): adds a stream and returns its id, Send() without one goes to stream 0
+int SenderSocket::OpenStream(int mode, int weight)
+{
+    if (engine)
+    {
+        return -1;
+    }
+    if (!streams)
+    {
+        streams = new StreamScheduler();
+    }
+    return streams->Add(mode, weight);
+}
+
+const SendStream *SenderSocket::getStream(int id)
+{
+    return streams ? streams->Get(id) : NULL;
+}
+
+uint64_t SenderSocket::getStartOffset()
 {
-    double alpha = 0.125, beta = 0.25;
-    estRTT = (1 - alpha) * estRTT + alpha * RTT;
-    devRTT = (1 - beta) * devRTT + beta * fabs(RTT - estRTT);
+    return startOffset;
+}
 
-    RTO = estRTT + 4 * max(devRTT, 0.01);
+void SenderSocket::saveCheckpoint()
+{
+    if (!checkpointPath || !handshakeDone)
+    {
+        return;
+    }
+    TransferCheckpoint ckpt;
+    ckpt.localPort = localPort;
+    engine->getAcked(ckpt.senderBase, ckpt.offset, ckpt.crc);
+    ckpt.Save(checkpointPath);
 }
 
 int SenderSocket::Open(char *targetHost, short port, int senderWindow, LinkProperties *linkProperties)
 {
-    stats = thread(&SenderSocket::StatsRun, this);
+    // error check for already open
+    sockaddr_in zeroAddr;
+    memset(&zeroAddr, 0, sizeof(zeroAddr));
+    if (memcmp(&zeroAddr, &remote, sizeof(sockaddr_in)) != 0)
+    {
+        return ALREADY_CONNECTED;
+    }
+
+    engine = makeSenderEngine<MAX_PKT_SIZE, ClockTimer>(senderWindow, fastRetxEnabled, this, trace);
+    // engine = makeSenderEngine<DUMMY_PKT_SIZE, ClockTimer>(senderWindow, fastRetxEnabled, this, trace);
+    engine->trackAcked = checkpointPath != NULL;
     // TODO: sends SYN and receives SYN-ACK
     // send a packet with syn set to 1
     // should recv with syn and ack both to 1
-    buffer = new Packet[senderWindow];
-    window = senderWindow;
+    int window = senderWindow;
     empty = CreateSemaphore(NULL, 0, window, NULL);
     full = CreateSemaphore(NULL, 0, window, NULL);
 
     socketReceiveReady = CreateEvent(NULL, false, false, NULL);
     eventQuit = CreateEvent(NULL, true, false, NULL);
     eventAllACKed = CreateEvent(NULL, true, false, NULL);
+    eventWorkerDone = CreateEvent(NULL, true, false, NULL);
+    eventCheckpointDue = CreateEvent(NULL, false, false, NULL);
     long networkMask = FD_READ;
     int r = WSAEventSelect(sock, socketReceiveReady, networkMask);
     if (r == SOCKET_ERROR)
@@ -91,22 +179,24 @@ int SenderSocket::Open(char *targetHost, short port, int senderWindow, LinkPrope
         exit(EXIT_FAILURE);
     }
 
-    RTO = max(1.0, (double)(2 * linkProperties->RTT));
-    estRTT = linkProperties->RTT;
-
-    // error check for already open
-    sockaddr_in zeroAddr;
-    memset(&zeroAddr, 0, sizeof(zeroAddr));
-    if (memcmp(&zeroAddr, &remote, sizeof(sockaddr_in)) != 0)
-    {
-        return ALREADY_CONNECTED;
-    }
+    engine->RTO = max(1.0, (double)(2 * linkProperties->RTT));
+    engine->estRTT = linkProperties->RTT;
 
     // prepare packet to send
-    SenderSynHeader ssh;
+    SenderResumeHeader srh;
+    SenderSynHeader &ssh = srh.ssh;
     ssh.sdh.flags.SYN = 1;
+    ssh.sdh.flags.COMPRESSED = compressed;
     memcpy(&ssh.lp, linkProperties, sizeof(LinkProperties));
-    ssh.sdh.seq = seqNum;
+    ssh.sdh.seq = engine->seqNum;
+    int synSize = sizeof(SenderSynHeader);
+    if (resuming)
+    {
+        ssh.sdh.seq = resume.senderBase;
+        srh.crc = resume.crc;
+        srh.session = GetTickCount() ^ (GetCurrentProcessId() << 16);
+        synSize = sizeof(SenderResumeHeader);
+    }
 
     // locate destination
     remote.sin_family = AF_INET;
@@ -136,12 +226,12 @@ int SenderSocket::Open(char *targetHost, short port, int senderWindow, LinkPrope
     socklen_t respLen = sizeof(response);
     int count = 0;
     int nfds = (int)(sock + 1);
-    while (count < maxRetx)
+    while (count < engine->maxRetx)
     {
         // send request to server
         double start = (double)clock() / CLOCKS_PER_SEC;
 
-        if (sendto(sock, (char *)(&ssh), sizeof(SenderSynHeader), 0, (sockaddr *)&remote, sizeof(remote)) == SOCKET_ERROR)
+        if (sendto(sock, (char *)(&srh), synSize, 0, (sockaddr *)&remote, sizeof(remote)) == SOCKET_ERROR)
         {
             printf("[%.3f]  --> failed with %d on sendto()\n", getElapsedTime(), WSAGetLastError());
             return FAILED_SEND;
@@ -150,8 +240,8 @@ int SenderSocket::Open(char *targetHost, short port, int senderWindow, LinkPrope
         // prepare to receive
         // TODO: tie to RTO?
         timeval timeout;
-        timeout.tv_sec = (long)RTO;
-        timeout.tv_usec = (long)((RTO - timeout.tv_sec) * 1e6);
+        timeout.tv_sec = (long)engine->RTO;
+        timeout.tv_usec = (long)((engine->RTO - timeout.tv_sec) * 1e6);
         fd_set fd;
         FD_ZERO(&fd);      // clear the set
         FD_SET(sock, &fd); // add your socket to the set
@@ -174,13 +264,50 @@ int SenderSocket::Open(char *targetHost, short port, int senderWindow, LinkPrope
                 printf("SYN-ACK not acknowledged!\n");
                 exit(EXIT_FAILURE);
             }
+            // a sharded receiver answers from the port of the shard that owns us, send there from now on
+            remote.sin_port = response.sin_port;
             double end = (double)clock() / CLOCKS_PER_SEC;
             double delta = end - start;
-            estRTT = delta;
-            devRTT = 0;
-            RTO = estRTT + 4 * max(devRTT, 0.01);
+            engine->estRTT = delta;
+            engine->devRTT = 0;
+            engine->RTO = engine->estRTT + 4 * max(engine->devRTT, 0.01);
+            if (trace)
+            {
+                TraceFileHeader hdr;
+                hdr.magic = TRACE_MAGIC;
+                hdr.window = window;
+                hdr.maxRetx = engine->maxRetx;
+                hdr.recvWnd = rh.recvWnd;
+                hdr.estRTT = engine->estRTT;
+                hdr.devRTT = engine->devRTT;
+                hdr.RTO = engine->RTO;
+                trace->WriteHeader(hdr);
+            }
+            // receiver echoes the resume seq when its CRC matched, anything else starts over at 0
+            if (resuming && rh.ackSeq == resume.senderBase)
+            {
+                engine->startAt(resume.senderBase, resume.offset, resume.crc);
+                startOffset = resume.offset;
+                lastStatsBase = resume.senderBase;
+                checkpointBase = resume.senderBase;
+            }
+            handshakeDone = true;
+
+            engine->receiverWindow = rh.recvWnd;
+            engine->effectiveWindow = min(window, (int)rh.recvWnd);
+            engine->lastReleased = engine->senderBase + engine->effectiveWindow;
+            if (streams)
+            {
+                streamTags = new StreamTag[window];
+                streamAckedSeq = engine->senderBase;
+                credits = engine->effectiveWindow;
+                streams->Reserve(engine->effectiveWindow);
+            }
+
             // TODO: change window afer part1
+            // both only once the handshake worked, a failed Open() leaves no thread behind
             worker = thread(&SenderSocket::WorkerRun, this);
+            stats = thread(&SenderSocket::StatsRun, this);
 
             if (!ResetEvent(socketReceiveReady))
             {
@@ -188,9 +315,7 @@ int SenderSocket::Open(char *targetHost, short port, int senderWindow, LinkPrope
                 exit(EXIT_FAILURE);
             }
 
-            lastReleased = min(window, (int)rh.recvWnd);
-            effectiveWindow = lastReleased;
-            if (!ReleaseSemaphore(empty, lastReleased, NULL))
+            if (!streams && !ReleaseSemaphore(empty, engine->effectiveWindow, NULL))
             {
                 printf("ReleaseSemaphore() failed with %d\n", WSAGetLastError());
                 exit(EXIT_FAILURE);
@@ -215,14 +340,14 @@ int SenderSocket::Open(char *targetHost, short port, int senderWindow, LinkPrope
         ++count;
     }
 
-    if (count == maxRetx)
+    if (count == engine->maxRetx)
     {
         return TIMEOUT;
     }
     return STATUS_OK;
 }
 
-void SenderSocket::sendPacket(const char *buf, const int &bytes)
+void SenderSocket::transmit(const char *buf, int bytes)
 {
     if (sendto(sock, buf, bytes, 0, (sockaddr *)&remote, sizeof(remote)) == SOCKET_ERROR)
     {
@@ -230,6 +355,67 @@ void SenderSocket::sendPacket(const char *buf, const int &bytes)
     }
 }
 
+void SenderSocket::releaseSlots(int count)
+{
+    // the receiver only remembers a few windows back, so the saved base must not fall further behind
+    if (checkpointPath && engine->senderBase - checkpointBase >= (DWORD)engine->effectiveWindow)
+    {
+        checkpointBase = engine->senderBase;
+        SetEvent(eventCheckpointDue);
+    }
+    if (streams)
+    {
+        streamsAcked();
+        credits += count;
+        return;
+    }
+    if (!ReleaseSemaphore(empty, count, NULL))
+    {
+        printf("ReleaseSemaphore() failed with %d on recv\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+}
+
+void SenderSocket::allAcked()
+{
+    SetEvent(eventAllACKed);
+}
+
+// charge the newly ACKed seqs to their streams
+void SenderSocket::streamsAcked()
+{
+    double now = engine->now();
+    for (; streamAckedSeq != engine->senderBase; ++streamAckedSeq)
+    {
+        StreamTag &tag = streamTags[streamAckedSeq % engine->window];
+        SendStream *s = streams->Get(tag.stream);
+        double delay = now - tag.queuedTime;
+        s->ackedBytes += tag.bytes;
+        ++s->ackedPkts;
+        s->delaySum += delay;
+        s->maxDelay = max(s->maxDelay, delay);
+    }
+}
+
+// a window slot is free and data of this class is queued: the scheduler decides whose it is
+void SenderSocket::sendFromStreams(int mode)
+{
+    --credits;
+    SendStream *s = streams->Pick(mode);
+    StreamChunk &chunk = s->Front();
+    s->maxWait = max(s->maxWait, engine->now() - chunk.queuedTime);
+
+    StreamTag &tag = streamTags[engine->seqNum % engine->window];
+    tag.stream = s->id;
+    tag.bytes = chunk.size;
+    tag.queuedTime = chunk.queuedTime;
+
+    engine->buildStreamPacket(chunk.data, chunk.size, (WORD)s->id, s->nextSeq++);
+    s->sentBytes += chunk.size;
+    streams->Pop(s);
+    engine->onSendReady();
+}
+
 void SenderSocket::WorkerRun()
 {
     int kernelBuffer = 20e6; // 20 meg
@@ -246,205 +432,207 @@ void SenderSocket::WorkerRun()
     }
     SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
 
-    HANDLE events[] = {socketReceiveReady, full, eventQuit};
+    HANDLE events[] = {socketReceiveReady, eventQuit, streams ? streams->strictPending : full,
+                       streams ? streams->pending : NULL};
 
     while (true)
     {
-        DWORD timeout = INFINITE;
-        if (senderBase != nextToSend)
+        DWORD timeout = engine->timeoutMs();
+        // with streams, queued data is only picked up while the window has room for it,
+        // and weighted data only while there is more room than the strict reserve
+        DWORD nEvents = 3;
+        if (streams)
         {
-            timeout = (DWORD)((timerExpire - ((double)clock() / CLOCKS_PER_SEC)) * 1000);
+            nEvents = (credits == 0) ? 2 : (credits > streams->reserve ? 4 : 3);
         }
-        int result = WaitForMultipleObjects(3, events, false, timeout);
+        int result = WaitForMultipleObjects(nEvents, events, false, timeout);
         if (result == WAIT_FAILED || result == WAIT_ABANDONED)
         {
             printf("WaitForSingleObject() failed with %d\n", WSAGetLastError());
             exit(EXIT_FAILURE);
         }
-        recomputeTimerExpire = false;
         switch (result)
         {
         case WAIT_TIMEOUT:
-            recomputeTimerExpire = true;
-            // resendbase
-            {
-                Packet *pkt = buffer + (senderBase % window);
-                sendPacket(pkt->pkt, pkt->size);
-            }
-            ++baseRetxCount;
-            ++timeoutCount;
-            if (baseRetxCount == maxRetx)
-            {
-                exceededRetx = true;
-                return;
-            }
+            engine->onTimeout();
             break;
         case WAIT_OBJECT_0:
             recvPacket();
             break;
         case (WAIT_OBJECT_0 + 1):
-        {
-            Packet *pkt = buffer + (nextToSend % window);
-            sendPacket(pkt->pkt, pkt->size);
-            pkt->txTime = clock();
-
-            if (nextToSend == senderBase)
+            return;
+        case (WAIT_OBJECT_0 + 2):
+            if (streams)
             {
-                recomputeTimerExpire = true;
+                sendFromStreams(STREAM_STRICT);
+            }
+            else
+            {
+                engine->onSendReady();
             }
-
-            ++nextToSend;
             break;
-        }
-        case (WAIT_OBJECT_0 + 2):
-            return;
+        case (WAIT_OBJECT_0 + 3):
+            sendFromStreams(STREAM_WEIGHTED);
+            break;
         default:
             printf("error encountered\n");
             exit(EXIT_FAILURE);
         }
 
-        if (recomputeTimerExpire)
+        // maxRetx on a timeout or a fast retx: wake whoever waits on a slot or on the last ACK
+        if (engine->exceededRetx)
         {
-            timerExpire = ((double)clock() / CLOCKS_PER_SEC) + RTO;
+            SetEvent(eventWorkerDone);
+            SetEvent(eventAllACKed);
+            return;
         }
+        engine->armTimer();
     }
 }
 
 void SenderSocket::StatsRun()
 {
     lastStatsTime = getElapsedTime();
-    lastStatsBase = senderBase;
-    while (WaitForSingleObject(eventQuit, 2000) == WAIT_TIMEOUT)
+    lastStatsBase = engine->senderBase;
+    HANDLE events[] = {eventQuit, eventCheckpointDue};
+    while (true)
     {
+        DWORD wait = (DWORD)(max(0.0, lastStatsTime + 2.0 - getElapsedTime()) * 1000);
+        DWORD result = WaitForMultipleObjects(2, events, false, wait);
+        if (result == WAIT_FAILED || result == WAIT_ABANDONED)
+        {
+            printf("WaitForMultipleObjects() failed with %d\n", WSAGetLastError());
+            exit(EXIT_FAILURE);
+        }
+        if (result == WAIT_OBJECT_0)
+        {
+            break;
+        }
+        if (result == WAIT_OBJECT_0 + 1)
+        {
+            saveCheckpoint();
+            continue;
+        }
 
         double now = getElapsedTime();
         double dt = now - lastStatsTime;
-        DWORD b = senderBase;
-        DWORD n = nextToSend;
+        DWORD b = engine->senderBase;
+        DWORD n = engine->nextToSend;
 
         DWORD deltaAckPkts = (b >= lastStatsBase) ? (b - lastStatsBase) : 0;
 
         if (dt > 0)
         {
-            goodput = (deltaAckPkts * 8 * (MAX_PKT_SIZE - sizeof(SenderDataHeader))) / (dt * 1e6);
+            goodput = (deltaAckPkts * 8 * engine->payloadSize) / (dt * 1e6);
         }
 
-        double mbDelivered = totalAckedBytes / (1e6);
+        double mbDelivered = engine->totalAckedBytes / (1e6);
 
         printf("[%2d] B %5u ( %4.1f MB) N %5u T %d F %d W %u S %.3f Mbps RTT %.3f\n",
                (int)now,
                b,
                mbDelivered,
                n,
-               timeoutCount,
-               fastRetx,
-               (unsigned)effectiveWindow,
+               engine->timeoutCount,
+               engine->fastRetx,
+               (unsigned)engine->effectiveWindow,
                goodput,
-               estRTT);
+               engine->estRTT);
+
+        for (int i = 0; streams && i < streams->Count(); ++i)
+        {
+            SendStream *s = streams->Get(i);
+            printf("     stream %d %c Q %3d A %6.1f MB D %.0f/%.0f ms\n",
+                   s->id,
+                   s->mode == STREAM_STRICT ? 'S' : 'W',
+                   (int)s->queued,
+                   s->ackedBytes / 1e6,
+                   s->ackedPkts ? 1e3 * s->delaySum / s->ackedPkts : 0.0,
+                   1e3 * s->maxDelay);
+        }
 
         lastStatsTime = now;
         lastStatsBase = b;
+
+        saveCheckpoint();
     }
 }
 
+// drains whatever ACKs are queued on the socket, so a burst costs one window update
 void SenderSocket::recvPacket()
 {
-    ReceiverHeader rh;
-    int bytes = recvfrom(sock, (char *)(&rh), sizeof(ReceiverHeader), 0, NULL, NULL);
-    if (bytes == SOCKET_ERROR)
-    {
-        printf("recvfrom() failed with %d\n", WSAGetLastError());
-        exit(EXIT_FAILURE);
-    }
-
-    // check if FIN-ACK is recvd
-    if (rh.flags.FIN == 1 && rh.flags.ACK == 1)
-    {
-        printf("[%.3f]  <-- FIN-ACK %u window %X\n", getElapsedTime(), rh.ackSeq, rh.recvWnd);
-        SetEvent(eventQuit);
-        return;
-    }
-
-    DWORD ack = rh.ackSeq;
-    receiverWindow = rh.recvWnd;
-
-    if (ack == seqNum)
-    {
-        SetEvent(eventAllACKed);
-    }
-
-    Packet *pkt = buffer + ((ack - 1) % window);
-    double RTT = ((double)clock() / CLOCKS_PER_SEC) - ((double)(pkt->txTime) / CLOCKS_PER_SEC);
-
-    if (ack > senderBase)
+    ReceiverHeader acks[ACK_BATCH];
+    int count = 0;
+    while (count < ACK_BATCH)
     {
-        if (baseRetxCount == 0)
+        ReceiverHeader &rh = acks[count];
+        int bytes = recvfrom(sock, (char *)(&rh), sizeof(ReceiverHeader), 0, NULL, NULL);
+        if (bytes == SOCKET_ERROR)
         {
-            updateRTO(RTT);
+            // the socket is non-blocking after WSAEventSelect, this just means it is empty
+            if (WSAGetLastError() == WSAEWOULDBLOCK)
+            {
+                break;
+            }
+            printf("recvfrom() failed with %d\n", WSAGetLastError());
+            exit(EXIT_FAILURE);
         }
-
-        dupACK = 0;
-        baseRetxCount = 0;
-        recomputeTimerExpire = true;
-        DWORD newlyAcked = ack - senderBase;
-
-        totalAckedBytes += newlyAcked * (MAX_PKT_SIZE - sizeof(SenderDataHeader));
-
-        senderBase = ack;
-        effectiveWindow = min(window, (int)rh.recvWnd);
-        newReleased = senderBase + effectiveWindow - lastReleased;
-        lastReleased += newReleased;
-
-        if (!ReleaseSemaphore(empty, newReleased, NULL))
+        // the receiver answers a late copy of our SYN again, that is not an ACK
+        if (rh.flags.SYN == 1)
         {
-            printf("ReleaseSemaphore() failed with %d on recv\n", WSAGetLastError());
-            exit(EXIT_FAILURE);
+            continue;
         }
-    }
-    // this part is for triple duplicate ack
-    else if (ack == senderBase)
-    {
-        // check counter and resend once it equals 3
-        // same thing as timeout and reset variables
-        ++dupACK;
-        if (dupACK == 3)
+
+        // check if FIN-ACK is recvd
+        if (rh.flags.FIN == 1 && rh.flags.ACK == 1)
         {
-            Packet *pkt = buffer + (senderBase % window);
-            sendPacket(pkt->pkt, pkt->size);
-            recomputeTimerExpire = true;
-            ++baseRetxCount;
-            ++fastRetx;
-            if (baseRetxCount == maxRetx)
+            engine->processAcks(acks, count);
+            if (trace)
             {
-                exceededRetx = true;
-                return;
+                trace->Record(engine->now(), TRACE_RX, PacketTrace::FlagBits(rh.flags), 0, rh.ackSeq, rh.recvWnd);
             }
+            printf("[%.3f]  <-- FIN-ACK %u window %X\n", getElapsedTime(), rh.ackSeq, rh.recvWnd);
+            SetEvent(eventQuit);
+            return;
         }
+        ++count;
     }
+
+    // a full batch may have left more behind, FD_READ fires again for those
+    engine->processAcks(acks, count);
 }
 
 int SenderSocket::Send(char *buf, int bytes)
 {
-    if (exceededRetx) {
-        return TIMEOUT;
+    if (streams)
+    {
+        return Send(buf, bytes, 0);
+    }
+    if (!handshakeDone)
+    {
+        return NOT_CONNECTED;
+    }
+    // one segment per call, a larger buffer would run past the packet
+    if (bytes < 0 || bytes > engine->payloadSize)
+    {
+        return INVALID_ARGUMENT;
     }
     // follow the picture from class
-    DWORD result = WaitForSingleObject(empty, INFINITE);
+    HANDLE events[] = {empty, eventWorkerDone};
+    DWORD result = WaitForMultipleObjects(2, events, false, INFINITE);
     if (result == WAIT_FAILED || result == WAIT_ABANDONED)
     {
-        printf("WaitForSingleObject() failed with %d\n", WSAGetLastError());
+        printf("WaitForMultipleObjects() failed with %d\n", WSAGetLastError());
         exit(EXIT_FAILURE);
     }
+    if (result == WAIT_OBJECT_0 + 1)
+    {
+        saveCheckpoint();
+        return TIMEOUT;
+    }
 
     // build packet
-    int pktSize = bytes + sizeof(SenderDataHeader);
-    Packet *pkt = buffer + (seqNum % window);
-    SenderDataHeader sdh;
-    sdh.seq = seqNum;
-    memcpy(pkt->pkt, &sdh, sizeof(SenderDataHeader));
-    memcpy(pkt->pkt + sizeof(SenderDataHeader), buf, bytes);
-    pkt->size = pktSize;
-    // pkt->txTime = clock();
+    engine->buildPacket(buf, bytes);
 
     result = ReleaseSemaphore(full, 1, NULL);
     if (result == 0)
@@ -453,15 +641,60 @@ int SenderSocket::Send(char *buf, int bytes)
         exit(EXIT_FAILURE);
     }
 
-    ++seqNum;
-
     return STATUS_OK;
 }
 
+// queues bytes (at most STREAM_PAYLOAD, INVALID_ARGUMENT past that) on one stream; the worker decides when they go out
+int SenderSocket::Send(char *buf, int bytes, int stream)
+{
+    if (!handshakeDone)
+    {
+        return NOT_CONNECTED;
+    }
+    if (!streams || !streams->Get(stream))
+    {
+        return INVALID_STREAM;
+    }
+    if (bytes < 0 || bytes > STREAM_PAYLOAD)
+    {
+        return INVALID_ARGUMENT;
+    }
+    int status = streams->Push(stream, buf, bytes, engine->now(), eventWorkerDone);
+    if (status == TIMEOUT)
+    {
+        saveCheckpoint();
+    }
+    return status;
+}
+
 int SenderSocket::Close(double &elapsedTime)
 {
+    if (!handshakeDone)
+    {
+        return NOT_CONNECTED;
+    }
 
-    WaitForSingleObject(eventAllACKed, INFINITE);
+    // the event also fires whenever the window drains mid-transfer, so check what it claims
+    while (true)
+    {
+        ResetEvent(eventAllACKed);
+        if (engine->exceededRetx ||
+            (engine->senderBase == (DWORD)engine->seqNum && (!streams || streams->Empty())))
+        {
+            break;
+        }
+        WaitForSingleObject(eventAllACKed, INFINITE);
+    }
+
+    // the worker is gone, there is nobody left to take a FIN-ACK
+    if (engine->exceededRetx)
+    {
+        SetEvent(eventQuit);
+        worker.join();
+        stats.join();
+        saveCheckpoint();
+        return TIMEOUT;
+    }
 
     elapsedTime = (double)clock() / CLOCKS_PER_SEC;
 
@@ -470,7 +703,7 @@ int SenderSocket::Close(double &elapsedTime)
     // prepare packet to send
     SenderDataHeader sdh;
     sdh.flags.FIN = 1;
-    sdh.seq = seqNum;
+    sdh.seq = engine->seqNum;
 
     // error check
     sockaddr_in zeroAddr;
@@ -488,7 +721,7 @@ int SenderSocket::Close(double &elapsedTime)
     int count = 0;
     int nfds = (int)(sock + 1);
     // todo: quit after max count
-    while (WaitForSingleObject(eventQuit, (DWORD)(RTO * 1000)) == WAIT_TIMEOUT && count < maxRetx)
+    while (WaitForSingleObject(eventQuit, (DWORD)(engine->RTO * 1000)) == WAIT_TIMEOUT && count < engine->maxRetx)
     {
         // send request to server
         double start = getElapsedTime();
@@ -501,7 +734,7 @@ int SenderSocket::Close(double &elapsedTime)
         ++count;
     }
 
-    if (count == maxRetx)
+    if (count == engine->maxRetx)
     {
         return TIMEOUT;
     }
@@ -513,5 +746,5 @@ int SenderSocket::Close(double &elapsedTime)
 
 double SenderSocket::getEstRTT()
 {
-    return estRTT;
+    return engine ? engine->estRTT : 0.0;
 }
@@ -14,6 +14,9 @@
 #pragma comment(lib, "Ws2_32.lib")
 
 #include "PacketHeaders.h"
+#include "PacketTrace.h"
+#include "SenderCore.h"
+#include "TransferCheckpoint.h"
 #include <chrono>
 #include <mutex>
 #include <thread>
@@ -22,6 +25,7 @@
 #define MAGIC_PORT 22345		 // receiver listens on this port
 #define MAX_PKT_SIZE (1500 - 28) // maximum UDP packet size accepted by receiver
 #define DUMMY_PKT_SIZE (9000-28) // 9KB for dummy receiver
+#define ACK_BATCH 64				 // most ACKs drained from the socket per wake-up
 
 // possible status codes from ss.Open, ss.Send, ss.Close
 #define STATUS_OK 0			// no error
@@ -31,76 +35,108 @@
 #define FAILED_SEND 4		// sendto() failed in kernel
 #define TIMEOUT 5			// timeout after all retx attempts are exhausted
 #define FAILED_RECV 6		// recvfrom() failed in kernel
+#define INVALID_STREAM 7	// ss.Send() on a stream that was never opened
+#define INVALID_ARGUMENT 8	// a size or count outside what the call can handle
 
 
-class Packet {
+typedef SegmentPacket<MAX_PKT_SIZE> Packet;
+// typedef SegmentPacket<DUMMY_PKT_SIZE> Packet; // for report
+
+class SendStream;
+class StreamScheduler;
+
+// which stream an in-flight seq belongs to, for per-stream ACK accounting
+class StreamTag
+{
+public:
+	int stream;
+	int bytes;
+	double queuedTime;
+};
+
+// what the send loop in main needs, single receiver or fan-out
+class TransferSocket
+{
 public:
-	// int type; // SYN, FIN, data
-	int size; // bytes in packet data
-	clock_t txTime; // transmission time
-	char pkt[MAX_PKT_SIZE]; // packet with header
-	// char pkt[DUMMY_PKT_SIZE]; // for report
+	virtual ~TransferSocket() {}
+	virtual int Send(char *buf, int bytes) = 0;
+	virtual int Close(double &elapsedTime) = 0;
+	virtual double getEstRTT() = 0;
 };
-class SenderSocket
+
+// thin facade over SenderCore: owns the socket, semaphores and threads, and
+// dispatches each event to the core specialized for this window
+class SenderSocket : public SenderTransport, public TransferSocket
 {
 private:
 	SOCKET sock;
 	sockaddr_in local;
 	sockaddr_in remote;
+	WORD localPort;
 	std::chrono::steady_clock::time_point constructedTime;
 	std::thread worker;
 	std::thread stats;
-	double RTO;
-	double estRTT;
-	double devRTT;
-	double timerExpire;
-	bool recomputeTimerExpire;
-	int baseRetxCount = 0;
-	int window;
-	DWORD senderBase = 0;
-	int produced = 0;
-	int seqNum = 0;
-	int nextToSend = 0;
-	int maxRetx = 50;
-	bool exceededRetx = false;
-	int dupACK = 0;
-	int effectiveWindow = 0;
-	int lastReleased = 0;
-	int newReleased = 0;
+	SenderEngine *engine = NULL;
+	bool fastRetxEnabled = true;
+	bool compressed = false;
 	// semaphores
 	HANDLE empty;
 	HANDLE full;
 	HANDLE socketReceiveReady;
 	HANDLE eventQuit;
 	HANDLE eventAllACKed;
-
-	// buffer
-	Packet* buffer;
+	HANDLE eventWorkerDone; // worker gave up after maxRetx, nothing frees a slot after this
+	HANDLE eventCheckpointDue;
 
 	// stats variables
 	double mb = 0.0;
-	uint64_t totalAckedBytes = 0;
 	double lastStatsTime = 0.0;
 	DWORD lastStatsBase = 0;
-	int timeoutCount = 0;
-	int fastRetx = 0;
-	DWORD receiverWindow = 0;
 	double goodput = 0.0;
 
+	// trace capture
+	PacketTrace *trace = NULL;
+
+	// checkpoint and resume
+	const char *checkpointPath = NULL;
+	TransferCheckpoint resume;
+	bool resuming = false;
+	DWORD checkpointBase = 0; // senderBase when the worker last asked for a checkpoint
+	bool handshakeDone = false; // Send() and Close() need this, not just an engine from a failed Open()
+	uint64_t startOffset = 0;
+
+	// multiplexed streams, NULL unless OpenStream() was called before Open()
+	StreamScheduler *streams = NULL;
+	StreamTag *streamTags = NULL;
+	int credits = 0; // free window slots, stands in for empty when streams are open
+	DWORD streamAckedSeq = 0;
+
 	// helpers
 	void closeSocket();
 	double getElapsedTime();
-	void updateRTO(double RTT);
-	void sendPacket(const char *buf, const int &bytes);
+	void transmit(const char *buf, int bytes);
+	void releaseSlots(int count);
+	void allAcked();
 	void WorkerRun();
 	void recvPacket();
 	void StatsRun();
+	void saveCheckpoint();
+	void sendFromStreams(int mode);
+	void streamsAcked();
 
 public:
-	SenderSocket();
+	SenderSocket(WORD bindPort = 0);
 	~SenderSocket();
 	int Open(char *targetHost, short port, int senderWindow, LinkProperties *linkProperties);
 	int Send(char *buf, int bytes);
+	int Send(char *buf, int bytes, int stream);
+	int OpenStream(int mode, int weight);
+	const SendStream *getStream(int id);
 	int Close(double &elapsedTime);
 	double getEstRTT();
+	void setTrace(PacketTrace *packetTrace);
+	void setFastRetx(bool enabled);
+	void setCompressed(bool enabled);
+	void setCheckpoint(const char *path, const TransferCheckpoint *resumeFrom);
+	uint64_t getStartOffset();
 };
@@ -0,0 +1,187 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "StreamScheduler.h"
+#include "pch.h"
+
+SendStream::SendStream(int streamId, int streamMode, int streamWeight)
+{
+    id = streamId;
+    mode = streamMode;
+    weight = max(1, streamWeight);
+    queue = new StreamChunk[STREAM_QUEUE_SIZE];
+    space = CreateSemaphore(NULL, STREAM_QUEUE_SIZE, STREAM_QUEUE_SIZE, NULL);
+}
+
+SendStream::~SendStream()
+{
+    delete[] queue;
+    CloseHandle(space);
+}
+
+StreamChunk &SendStream::Front()
+{
+    return queue[head];
+}
+
+StreamScheduler::StreamScheduler()
+{
+    strictPending = CreateSemaphore(NULL, 0, MAX_STREAMS * STREAM_QUEUE_SIZE, NULL);
+    pending = CreateSemaphore(NULL, 0, MAX_STREAMS * STREAM_QUEUE_SIZE, NULL);
+}
+
+StreamScheduler::~StreamScheduler()
+{
+    for (int i = 0; i < count; ++i)
+    {
+        delete streams[i];
+    }
+    CloseHandle(strictPending);
+    CloseHandle(pending);
+}
+
+// returns the new stream id, or -1 once MAX_STREAMS are open
+int StreamScheduler::Add(int mode, int weight)
+{
+    if (count == MAX_STREAMS)
+    {
+        return -1;
+    }
+    streams[count] = new SendStream(count, mode, weight);
+    return count++;
+}
+
+int StreamScheduler::Count()
+{
+    return count;
+}
+
+SendStream *StreamScheduler::Get(int id)
+{
+    return (id >= 0 && id < count) ? streams[id] : NULL;
+}
+
+// once the window is known: keep a few slots free of bulk so a strict message never waits
+// for a lost weighted packet's RTO to open one, a quarter of the window at most
+void StreamScheduler::Reserve(int window)
+{
+    reserve = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (streams[i]->mode == STREAM_STRICT)
+        {
+            reserve = min(STREAM_STRICT_RESERVE, window / 4);
+        }
+    }
+}
+
+// blocks while this stream's queue is full, other streams keep moving
+// waits for room on the stream, or returns TIMEOUT once abort is set;
+// INVALID_ARGUMENT if the chunk would not fit in one stream packet
+int StreamScheduler::Push(int id, const char *buf, int bytes, double now, HANDLE abort)
+{
+    if (bytes < 0 || bytes > STREAM_PAYLOAD)
+    {
+        return INVALID_ARGUMENT;
+    }
+    SendStream *s = streams[id];
+    HANDLE events[] = {s->space, abort};
+    DWORD result = WaitForMultipleObjects(2, events, false, INFINITE);
+    if (result == WAIT_FAILED || result == WAIT_ABANDONED)
+    {
+        printf("WaitForMultipleObjects() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+    if (result == WAIT_OBJECT_0 + 1)
+    {
+        return TIMEOUT;
+    }
+
+    StreamChunk &chunk = s->queue[s->tail];
+    memcpy(chunk.data, buf, bytes);
+    chunk.size = bytes;
+    chunk.queuedTime = now;
+    s->tail = (s->tail + 1) % STREAM_QUEUE_SIZE;
+    ++s->queued;
+
+    if (!ReleaseSemaphore(s->mode == STREAM_STRICT ? strictPending : pending, 1, NULL))
+    {
+        printf("ReleaseSemaphore() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+    return STATUS_OK;
+}
+
+// strict streams in the order they were opened, weighted ones by deficit round robin;
+// the worker only asks for a class its semaphore says has something queued
+SendStream *StreamScheduler::Pick(int mode)
+{
+    bool queued = false;
+    for (int i = 0; i < count; ++i)
+    {
+        if (streams[i]->queued == 0 || streams[i]->mode != mode)
+        {
+            continue;
+        }
+        if (mode == STREAM_STRICT)
+        {
+            return streams[i];
+        }
+        queued = true;
+    }
+    if (!queued)
+    {
+        return NULL;
+    }
+
+    while (true)
+    {
+        SendStream *s = streams[turn];
+        if (s->mode == STREAM_WEIGHTED)
+        {
+            if (s->queued == 0)
+            {
+                // an idle stream does not bank credit
+                s->deficit = 0;
+            }
+            else if (s->deficit >= s->Front().size)
+            {
+                s->deficit -= s->Front().size;
+                return s;
+            }
+        }
+
+        // pass the turn on, the next stream gets its quantum
+        turn = (turn + 1) % count;
+        if (streams[turn]->mode == STREAM_WEIGHTED && streams[turn]->queued > 0)
+        {
+            streams[turn]->deficit += streams[turn]->weight * STREAM_PAYLOAD;
+        }
+    }
+}
+
+void StreamScheduler::Pop(SendStream *s)
+{
+    s->head = (s->head + 1) % STREAM_QUEUE_SIZE;
+    --s->queued;
+    if (!ReleaseSemaphore(s->space, 1, NULL))
+    {
+        printf("ReleaseSemaphore() failed with %d\n", WSAGetLastError());
+        exit(EXIT_FAILURE);
+    }
+}
+
+bool StreamScheduler::Empty()
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if (streams[i]->queued > 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
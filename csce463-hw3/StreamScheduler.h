@@ -0,0 +1,83 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include "SenderSocket.h"
+#include <atomic>
+
+// CONSTANTS
+#define MAX_STREAMS 16                                              // streams per connection
+#define STREAM_QUEUE_SIZE 256                                       // packets queued per stream ahead of the window
+#define STREAM_PAYLOAD (MAX_PKT_SIZE - (int)sizeof(SenderStreamHeader)) // data bytes per stream packet
+#define STREAM_STRICT_RESERVE 4                                     // window slots weighted streams leave to strict ones
+
+// scheduling classes
+#define STREAM_STRICT 0   // served before any weighted stream, for small latency-sensitive messages
+#define STREAM_WEIGHTED 1 // shares what is left in proportion to its weight
+
+class StreamChunk
+{
+public:
+	int size;
+	double queuedTime; // when Send() handed it over (in sec)
+	char data[STREAM_PAYLOAD];
+};
+
+class SendStream
+{
+public:
+	int id;
+	int mode;
+	int weight;
+	int deficit = 0;  // bytes this stream may still send in its round-robin turn
+	DWORD nextSeq = 0; // next streamSeq
+
+	// filled by one Send() thread, drained by the worker
+	StreamChunk *queue;
+	int head = 0;
+	int tail = 0;
+	std::atomic<int> queued{0};
+	HANDLE space;
+
+	// flow accounting, worker thread only
+	uint64_t sentBytes = 0;
+	uint64_t ackedBytes = 0;
+	DWORD ackedPkts = 0;
+	double delaySum = 0.0; // Send() to ACK (in sec)
+	double maxDelay = 0.0;
+	double maxWait = 0.0; // Send() to first transmission, how long it sat waiting for a window slot (in sec)
+
+	SendStream(int streamId, int streamMode, int streamWeight);
+	~SendStream();
+	StreamChunk &Front();
+};
+
+// per-stream queues between Send() and the window; the worker picks which
+// stream fills each window slot that opens up
+class StreamScheduler
+{
+private:
+	SendStream *streams[MAX_STREAMS];
+	int count = 0;
+	int turn = 0; // weighted stream holding the round-robin turn
+
+public:
+	HANDLE strictPending; // packets queued across strict streams
+	HANDLE pending;       // packets queued across weighted streams
+	int reserve = 0;      // free window slots weighted streams may not take
+
+	StreamScheduler();
+	~StreamScheduler();
+	int Add(int mode, int weight);
+	int Count();
+	SendStream *Get(int id);
+	void Reserve(int window);
+	int Push(int id, const char *buf, int bytes, double now, HANDLE abort);
+	SendStream *Pick(int mode);
+	void Pop(SendStream *s);
+	bool Empty();
+};
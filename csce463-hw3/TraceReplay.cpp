@@ -0,0 +1,203 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "TraceReplay.h"
+#include "pch.h"
+
+#include <deque>
+
+using std::chrono::duration, std::chrono::duration_cast, std::chrono::steady_clock, std::deque;
+
+bool TraceReplay::Load(const char *path)
+{
+    records.clear();
+    if (!PacketTrace::Load(path, hdr, records))
+    {
+        return false;
+    }
+    printf("Replay: %s, W = %u, %zu records\n", path, hdr.window, records.size());
+    return true;
+}
+
+void TraceReplay::summarizeRecorded(ReplaySummary &sum)
+{
+    DWORD totalApp = 0;
+    double start = -1.0;
+    for (const TraceRecord &r : records)
+    {
+        if (r.type == TRACE_APP)
+        {
+            ++totalApp;
+            if (start < 0)
+            {
+                start = r.time;
+            }
+        }
+    }
+
+    for (const TraceRecord &r : records)
+    {
+        switch (r.type)
+        {
+        case TRACE_TX:
+            ++sum.tx;
+            break;
+        case TRACE_TIMEOUT:
+            ++sum.timeouts;
+            break;
+        case TRACE_FAST_RETX:
+            ++sum.fastRetx;
+            break;
+        case TRACE_RX:
+            if (!sum.finished && r.seq == totalApp)
+            {
+                sum.finished = true;
+                sum.duration = r.time - start;
+            }
+            break;
+        }
+    }
+}
+
+void TraceReplay::transmit(const char *buf, int bytes)
+{
+    // nothing goes on the wire, the output trace already has the TX record
+}
+
+void TraceReplay::releaseSlots(int count)
+{
+    credits += count;
+}
+
+void TraceReplay::allAcked()
+{
+}
+
+// fire every retx timer that expires before the next recorded event
+void TraceReplay::fireTimers(SenderEngine *core, double until)
+{
+    while (!core->exceededRetx && core->senderBase != core->nextToSend && core->timerExpire <= until)
+    {
+        VirtualTimer::time = core->timerExpire;
+        if (core->onTimeout())
+        {
+            return;
+        }
+        core->armTimer();
+    }
+}
+
+void TraceReplay::Run(PacketTrace *out, bool fastRetx)
+{
+    ReplaySummary recorded;
+    summarizeRecorded(recorded);
+
+    // same state Open() leaves behind after the handshake
+    VirtualTimer::time = 0.0;
+    SenderEngine *core = makeSenderEngine<MAX_PKT_SIZE, VirtualTimer>(hdr.window, fastRetx, this, out);
+    core->maxRetx = hdr.maxRetx;
+    core->estRTT = hdr.estRTT;
+    core->devRTT = hdr.devRTT;
+    core->RTO = hdr.RTO;
+    core->lastReleased = min(core->window, (int)hdr.recvWnd);
+    core->effectiveWindow = core->lastReleased;
+    credits = core->lastReleased;
+    if (out)
+    {
+        out->WriteHeader(hdr);
+    }
+
+    DWORD totalApp = 0;
+    for (const TraceRecord &r : records)
+    {
+        totalApp += (r.type == TRACE_APP);
+    }
+
+    char payload[MAX_PKT_SIZE];
+    memset(payload, 0, sizeof(payload));
+    deque<WORD> waiting; // Send() calls still blocked on a free slot
+    ReplaySummary replayed;
+    double start = -1.0;
+    uint64_t events = 0;
+
+    auto wallStart = steady_clock::now();
+    for (const TraceRecord &r : records)
+    {
+        if (r.type != TRACE_APP && r.type != TRACE_RX)
+        {
+            continue;
+        }
+        // FIN-ACK only matters to Close()
+        if (r.type == TRACE_RX && (r.flags & 1))
+        {
+            continue;
+        }
+
+        fireTimers(core, r.time);
+        if (core->exceededRetx)
+        {
+            break;
+        }
+        VirtualTimer::time = r.time;
+        ++events;
+
+        if (r.type == TRACE_APP)
+        {
+            if (start < 0)
+            {
+                start = r.time;
+            }
+            waiting.push_back(r.size);
+        }
+        else
+        {
+            ReceiverHeader rh;
+            rh.flags.SYN = (r.flags >> 2) & 1;
+            rh.flags.ACK = (r.flags >> 1) & 1;
+            rh.flags.FIN = r.flags & 1;
+            rh.ackSeq = r.seq;
+            rh.recvWnd = r.recvWnd;
+            core->processAck(rh);
+        }
+
+        // blocked Send() calls take the freed slots and the worker sends them right away
+        while (!waiting.empty() && credits > 0)
+        {
+            --credits;
+            core->buildPacket(payload, waiting.front());
+            waiting.pop_front();
+            core->onSendReady();
+        }
+
+        core->armTimer();
+
+        if (!replayed.finished && core->senderBase == totalApp)
+        {
+            replayed.finished = true;
+            replayed.duration = VirtualTimer::time - start;
+        }
+    }
+    double wall = duration_cast<duration<double>>(steady_clock::now() - wallStart).count();
+
+    replayed.timeouts = core->timeoutCount;
+    replayed.fastRetx = core->fastRetx;
+    replayed.tx = core->nextToSend + core->timeoutCount + core->fastRetx;
+
+    const char *state[] = {"unfinished", "finished"};
+    printf("Replay:   recorded %-10s in %.3f sec, tx %d, retx %d (T %d F %d)\n", state[recorded.finished],
+           recorded.duration, recorded.tx, recorded.timeouts + recorded.fastRetx, recorded.timeouts, recorded.fastRetx);
+    printf("Replay:   replayed %-10s in %.3f sec, tx %d, retx %d (T %d F %d), RTT %.3f\n", state[replayed.finished],
+           replayed.duration, replayed.tx, replayed.timeouts + replayed.fastRetx, replayed.timeouts, replayed.fastRetx,
+           core->estRTT);
+    printf("Replay:   replayed in %.3f sec of wall time, %.1f ns per event\n", wall,
+           events ? wall * 1e9 / events : 0.0);
+
+    if (out)
+    {
+        out->Close();
+    }
+    delete core;
+}
@@ -0,0 +1,43 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include "SenderSocket.h"
+#include "PacketTrace.h"
+#include <vector>
+
+class ReplaySummary
+{
+public:
+	double duration = 0.0; // first APP until everything is ACKed (in sec)
+	int tx = 0;
+	int timeouts = 0;
+	int fastRetx = 0;
+	bool finished = false;
+};
+
+// feeds a recorded trace's Send() calls and ACK arrivals through the current
+// SenderCore window/retx logic on a virtual clock; the replay is open loop,
+// so ACK timing is what the recorded run saw regardless of what we resend
+class TraceReplay : public SenderTransport
+{
+private:
+	TraceFileHeader hdr;
+	std::vector<TraceRecord> records;
+	int credits = 0; // stands in for the empty semaphore
+
+	// helpers
+	void transmit(const char *buf, int bytes);
+	void releaseSlots(int count);
+	void allAcked();
+	void summarizeRecorded(ReplaySummary &sum);
+	void fireTimers(SenderEngine *core, double until);
+
+public:
+	bool Load(const char *path);
+	void Run(PacketTrace *out, bool fastRetx);
+};
@@ -0,0 +1,53 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#include "TransferCheckpoint.h"
+#include "pch.h"
+
+// write to a temp file and swap it in, so a crash mid-write keeps the last checkpoint
+bool TransferCheckpoint::Save(const char *path) const
+{
+    char tmpPath[MAX_PATH];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+    FILE *f;
+    if (fopen_s(&f, tmpPath, "wb") != 0)
+    {
+        printf("failed to open checkpoint file %s\n", tmpPath);
+        return false;
+    }
+    size_t written = fwrite(this, sizeof(TransferCheckpoint), 1, f);
+    fclose(f);
+    if (written != 1)
+    {
+        printf("failed to write checkpoint file %s\n", tmpPath);
+        return false;
+    }
+
+    if (!MoveFileEx(tmpPath, path, MOVEFILE_REPLACE_EXISTING))
+    {
+        printf("MoveFileEx() failed with %d\n", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+bool TransferCheckpoint::Load(const char *path)
+{
+    FILE *f;
+    if (fopen_s(&f, path, "rb") != 0)
+    {
+        return false;
+    }
+    TransferCheckpoint ckpt;
+    bool ok = fread(&ckpt, sizeof(TransferCheckpoint), 1, f) == 1 && ckpt.magic == CHECKPOINT_MAGIC;
+    fclose(f);
+    if (ok)
+    {
+        *this = ckpt;
+    }
+    return ok;
+}
@@ -0,0 +1,29 @@
+/*
+* Giovan Ramirez-Rodarte
+* 432004695
+* CSCE 463 Fall 2025
+*/
+
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+
+// CONSTANTS
+#define CHECKPOINT_MAGIC 0x31504B43 // "CKP1"
+
+// everything the receiver has cumulatively ACKed, enough to resume from there
+#pragma pack(push, 1)
+class TransferCheckpoint
+{
+public:
+	DWORD magic = CHECKPOINT_MAGIC;
+	WORD localPort = 0;   // resuming from the same port keeps the receiver's connection (and shard)
+	DWORD senderBase = 0; // next seq to send
+	uint64_t offset = 0;  // payload bytes ACKed
+	DWORD crc = 0;        // CRC32 of those bytes
+
+	bool Save(const char *path) const;
+	bool Load(const char *path);
+};
+#pragma pack(pop)
@@ -10,7 +10,7 @@
 #include "pch.h"
 
 
-using std::chrono::duration, std::chrono::duration_cast, std::chrono::high_resolution_clock, std::chrono::milliseconds;
+using std::chrono::duration, std::chrono::duration_cast, std::chrono::high_resolution_clock;
 
 static void initializeWinsock()
 {
@@ -26,29 +26,161 @@ static void initializeWinsock()
     }
 }
 
+static void printUsage()
+{
+    printf(
+        "Incorrect Usage!\n\n"
+        "Usage:\n"
+        "    ./csce463-hw3{.exe} <destination_server> <buffer_size> <sender_window> <propagation_delay> <forward_loss> <return_loss> <bottleneck_speed> [options]\n\n"
+        "Arguments:\n"
+        "    destination_server    Hostname or IP of the destination server, comma-separated to fan out\n"
+        "    buffer_size           Power of 2 for buffer size\n"
+        "    sender_window         Number of packets in the sender's window\n"
+        "    propagation_delay     Propagation delay in seconds\n"
+        "    forward_loss          Probability of packet loss in the forward direction\n"
+        "    return_loss           Probability of packet loss in the return direction\n"
+        "    bottleneck_speed      Bottleneck speed in Mbps\n\n"
+        "Options:\n"
+        "    -z <threads>          Compress the payload in blocks on this many worker threads\n"
+        "    -t <trace_file>       Record a packet trace of the transfer\n"
+        "    -n                    No fast retransmit, recover from timeouts only\n"
+        "    -c <checkpoint_file>  Save progress there and resume from it on the next run\n"
+        "    -u <interval_ms>      Send a small urgent message this often on a strict-priority stream\n"
+        "    -i <threads>          Initialize the buffer on this many threads (default: one per processor)\n"
+        "    -o                    Overlap buffer initialization with the handshake and sending\n\n"
+        "Receiver mode:\n"
+        "    ./csce463-hw3{.exe} -r <shards> [receiver_window] [ack_every] [ack_delay_ms]\n"
+        "    shards                1 to 64 worker threads\n"
+        "    receiver_window       Advertised window in packets (default: 4096)\n"
+        "    ack_every             ACK every this many in-order packets (default: 1)\n"
+        "    ack_delay_ms          Longest an ACK is held back when ack_every > 1, up to 1000 (default: 5)\n\n"
+        "Replay mode:\n"
+        "    ./csce463-hw3{.exe} -p <trace_file> [output_trace] [-n]\n\n"
+        "Self-test mode:\n"
+        "    ./csce463-hw3{.exe} -s [test_name]\n");
+}
+
+// the whole string must be a number in [lo, hi]
+static bool parseInt(const char *s, int lo, int hi, int &value)
+{
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno == ERANGE || v < lo || v > hi)
+    {
+        return false;
+    }
+    value = (int)v;
+    return true;
+}
+
 static void cleanUpWinsock()
 {
     // call cleanup when done with everything and ready to exit program
     WSACleanup();
 }
 
+static int runReceiver(int shards, int recvWindow, int ackEvery, DWORD ackDelayMs)
+{
+    ReceiverEngine engine;
+    int status = engine.Start(MAGIC_PORT, shards, recvWindow, ackEvery, ackDelayMs);
+    if (status != STATUS_OK)
+    {
+        printf("Main:   receiver failed to start with status %d\n", status);
+        return EXIT_FAILURE;
+    }
+    printf("Main:   receiving, press Enter to stop\n");
+    getchar();
+    engine.Stop();
+    return 0;
+}
+
+// pings a strict-priority stream while the bulk transfer runs on another one
+static void urgentRun(SenderSocket *ss, int stream, int intervalMs, HANDLE eventDone)
+{
+    char msg[64];
+    int n = 0;
+    while (WaitForSingleObject(eventDone, intervalMs) == WAIT_TIMEOUT)
+    {
+        int bytes = snprintf(msg, sizeof(msg), "urgent %d", n++);
+        if (ss->Send(msg, bytes, stream) != STATUS_OK)
+        {
+            return;
+        }
+    }
+}
+
+static int runReplay(const char *tracePath, const char *outPath, bool fastRetx)
+{
+    TraceReplay replay;
+    if (!replay.Load(tracePath))
+    {
+        return EXIT_FAILURE;
+    }
+    PacketTrace out;
+    if (outPath && !out.Create(outPath))
+    {
+        return EXIT_FAILURE;
+    }
+    replay.Run(outPath ? &out : NULL, fastRetx);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
-    // error check for 7 args
-    if (argc != 8)
-    {
-        printf(
-            "Incorrect Usage!\n\n"
-            "Usage:\n"
-            "    ./csce463-hw3{.exe} <destination_server> <buffer_size> <sender_window> <propagation_delay> <forward_loss> <return_loss> <bottleneck_speed>\n\n"
-            "Arguments:\n"
-            "    destination_server    Hostname or IP of the destination server\n"
-            "    buffer_size           Power of 2 for buffer size\n"
-            "    sender_window         Number of packets in the sender's window\n"
-            "    propagation_delay     Propagation delay in seconds\n"
-            "    forward_loss          Probability of packet loss in the forward direction\n"
-            "    return_loss           Probability of packet loss in the return direction\n"
-            "    bottleneck_speed      Bottleneck speed in Mbps\n");
+    // receiver mode: -r <shards> [receiver_window] [ack_every] [ack_delay_ms]
+    if (argc >= 3 && strcmp(argv[1], "-r") == 0)
+    {
+        int shards;
+        int recvWindow = RECV_WINDOW;
+        int ackEvery = 1;
+        int ackDelayMs = ACK_DELAY_MS;
+        if (argc > 6 || !parseInt(argv[2], 1, MAX_SHARDS, shards) ||
+            (argc >= 4 && !parseInt(argv[3], 1, MAX_RECV_WINDOW, recvWindow)) ||
+            (argc >= 5 && !parseInt(argv[4], 1, recvWindow, ackEvery)) ||
+            (argc >= 6 && !parseInt(argv[5], 0, MAX_ACK_DELAY_MS, ackDelayMs)))
+        {
+            printUsage();
+            exit(EXIT_FAILURE);
+        }
+        initializeWinsock();
+        int result = runReceiver(shards, recvWindow, ackEvery, (DWORD)ackDelayMs);
+        cleanUpWinsock();
+        return result;
+    }
+
+    // replay mode: -p <trace_file> [output_trace] [-n]
+    if (argc >= 3 && strcmp(argv[1], "-p") == 0)
+    {
+        const char *outPath = NULL;
+        bool fastRetx = true;
+        for (int i = 3; i < argc; ++i)
+        {
+            if (strcmp(argv[i], "-n") == 0)
+            {
+                fastRetx = false;
+            }
+            else
+            {
+                outPath = argv[i];
+            }
+        }
+        return runReplay(argv[2], outPath, fastRetx);
+    }
+
+    // self-test mode: -s [test_name]
+    if (argc >= 2 && strcmp(argv[1], "-s") == 0)
+    {
+        initializeWinsock();
+        int result = SelfTest::Run(argc >= 3 ? argv[2] : NULL);
+        cleanUpWinsock();
+        return result;
+    }
+
+    // error check for 7 args plus options
+    if (argc < 8)
+    {
+        printUsage();
         exit(EXIT_FAILURE);
     }
 
@@ -63,22 +195,162 @@ int main(int argc, char *argv[])
     float returnLoss = (float)atof(argv[6]);
     int linkSpeed = atoi(argv[7]);
 
+    int compressThreads = 0;
+    const char *tracePath = NULL;
+    const char *checkpointPath = NULL;
+    bool fastRetx = true;
+    int urgentMs = 0;
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    int initThreads = (int)sysInfo.dwNumberOfProcessors;
+    bool overlapInit = false;
+    for (int i = 8; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-z") == 0 && i + 1 < argc)
+        {
+            compressThreads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-n") == 0)
+        {
+            fastRetx = false;
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            checkpointPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+        {
+            urgentMs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+        {
+            initThreads = max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-o") == 0)
+        {
+            overlapInit = true;
+        }
+        else
+        {
+            printUsage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    // compressed offsets depend on block packing, so only raw transfers resume
+    if (compressThreads > 0 && checkpointPath)
+    {
+        printf("Main:   -z and -c cannot be combined\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // a, b, c fans the same buffer out to every receiver listed
+    std::vector<char *> fanoutHosts;
+    char *context = NULL;
+    for (char *host = strtok_s(targetHost, ",", &context); host; host = strtok_s(NULL, ",", &context))
+    {
+        fanoutHosts.push_back(host);
+    }
+    int fanoutCount = (int)fanoutHosts.size();
+    bool fanout = fanoutCount > 1;
+    if (fanout && (tracePath || checkpointPath || urgentMs > 0))
+    {
+        printf("Main:   -t, -c and -u need a single receiver\n");
+        exit(EXIT_FAILURE);
+    }
+    // stream packets carry a longer header, so checkpoint offsets would not line up
+    if (urgentMs > 0 && checkpointPath)
+    {
+        printf("Main:   -u and -c cannot be combined\n");
+        exit(EXIT_FAILURE);
+    }
+    // compressed blocks span packets, urgent messages in between would split them
+    if (urgentMs > 0 && compressThreads > 0)
+    {
+        printf("Main:   -u and -z cannot be combined\n");
+        exit(EXIT_FAILURE);
+    }
+
     printf("Main:   sender W = %d, RTT %.3f sec, loss %g / %g, link %d Mbps\n", senderWindow, propagationDelay, forwardLoss, returnLoss, linkSpeed);
 
     // initialize dword buffer
     uint64_t dwordBufSize = (uint64_t)1 << power;
-    DWORD *dwordBuf = new DWORD[dwordBufSize];
-    printf("Main:   initializing DWORD array with 2^%d elements... ", power);
-    auto start = high_resolution_clock::now();
-    for (uint64_t i = 0; i < dwordBufSize; ++i)
+    BufferInit *init = new BufferInit(power, initThreads);
+    DWORD *dwordBuf = init->getBuffer();
+    printf("Main:   initializing DWORD array with 2^%d elements on %d threads, %d NUMA nodes... ", power,
+           init->getThreads(), init->getNodes());
+    init->Start();
+    if (overlapInit)
+    {
+        printf("overlapped with the transfer\n");
+    }
+    else
     {
-        dwordBuf[i] = (DWORD)i;
+        init->Join();
+        printf("done in %lld ms\n", init->getElapsedMs());
+    }
+
+    char *charBuf = (char *)dwordBuf;
+    uint64_t byteBufferSize = dwordBufSize << 2;
+
+    // a checkpoint is only worth resuming if our own data up to it is unchanged
+    TransferCheckpoint resume;
+    bool resuming = false;
+    if (checkpointPath && resume.Load(checkpointPath))
+    {
+        RunningChecksum prefix;
+        if (resume.offset <= byteBufferSize)
+        {
+            init->WaitUntil(resume.offset);
+            prefix.Update((unsigned char *)charBuf, resume.offset);
+        }
+        resuming = resume.offset <= byteBufferSize && prefix.Value() == resume.crc;
+        printf("Main:   checkpoint at byte %llu %s\n", resume.offset, resuming ? "matches, resuming" : "does not match this buffer, starting over");
     }
-    auto elapsed = duration_cast<milliseconds>(high_resolution_clock::now() - start);
-    printf("done in %lld ms\n", elapsed.count());
 
     // instantiate sendersocket class
-    SenderSocket ss;
+    SenderSocket *ss = NULL;
+    FanoutSenderSocket *fs = NULL;
+    TransferSocket *sock;
+    PacketTrace trace;
+    int urgentStream = -1;
+    if (fanout)
+    {
+        fs = new FanoutSenderSocket();
+        fs->setFastRetx(fastRetx);
+        fs->setCompressed(compressThreads > 0);
+        sock = fs;
+    }
+    else
+    {
+        ss = new SenderSocket(resuming ? resume.localPort : 0);
+        ss->setFastRetx(fastRetx);
+        ss->setCompressed(compressThreads > 0);
+        if (checkpointPath)
+        {
+            ss->setCheckpoint(checkpointPath, resuming ? &resume : NULL);
+        }
+        if (tracePath)
+        {
+            if (!trace.Create(tracePath))
+            {
+                delete ss;
+                delete init;
+                exit(EXIT_FAILURE);
+            }
+            ss->setTrace(&trace);
+        }
+        if (urgentMs > 0)
+        {
+            // bulk goes first so plain Send() lands on it
+            ss->OpenStream(STREAM_WEIGHTED, 1);
+            urgentStream = ss->OpenStream(STREAM_STRICT, 0);
+        }
+        sock = ss;
+    }
 
     // open connection
     LinkProperties lp;
@@ -87,8 +359,9 @@ int main(int argc, char *argv[])
     lp.pLoss[FORWARD_PATH] = forwardLoss;
     lp.pLoss[RETURN_PATH] = returnLoss;
     lp.bufferSize = (DWORD)(senderWindow + 5);
-    start = high_resolution_clock::now();
-    int status = ss.Open(targetHost, MAGIC_PORT, senderWindow, &lp);
+    auto start = high_resolution_clock::now();
+    int status = fanout ? fs->Open(fanoutHosts.data(), fanoutCount, MAGIC_PORT, senderWindow, &lp)
+                        : ss->Open(targetHost, MAGIC_PORT, senderWindow, &lp);
     double secs = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
     double s = (double)clock() / CLOCKS_PER_SEC;
 
@@ -96,39 +369,126 @@ int main(int argc, char *argv[])
     if (status != STATUS_OK)
     {
         printf("connect failed with status %d\n", status);
-        delete[] dwordBuf;
+        delete sock;
+        delete init;
         exit(EXIT_FAILURE);
     }
-    printf("connected to %s in %.3f sec, pkt size %d bytes\n", targetHost, secs, MAX_PKT_SIZE);
+    if (fanout)
+    {
+        printf("fanning out to %d receivers, connected in %.3f sec, pkt size %d bytes\n", fanoutCount, secs, MAX_PKT_SIZE);
+    }
+    else
+    {
+        printf("connected to %s in %.3f sec, pkt size %d bytes\n", targetHost, secs, MAX_PKT_SIZE);
+    }
     // printf("connected to %s in %.3f sec, pkt size %d bytes\n", targetHost, secs, DUMMY_PKT_SIZE);
 
 
 
     // send loop
-    char *charBuf = (char *)dwordBuf;
-    uint64_t byteBufferSize = dwordBufSize << 2;
 
-    uint64_t off = 0; // current position in buffer
-    while (off < byteBufferSize)
+    int payloadSize = (urgentStream >= 0) ? STREAM_PAYLOAD : MAX_PKT_SIZE - sizeof(SenderDataHeader);
+    // int payloadSize = DUMMY_PKT_SIZE - sizeof(SenderDataHeader);
+    uint64_t startOffset = ss ? ss->getStartOffset() : 0;
+    if (startOffset > 0)
+    {
+        printf("Main:   receiver verified the first %llu bytes, resuming there\n", startOffset);
+    }
+    else if (resuming)
+    {
+        printf("Main:   receiver could not verify the checkpoint, starting over\n");
+    }
+    uint64_t wireBytes = byteBufferSize - startOffset;
+    HANDLE eventBulkDone = NULL;
+    std::thread urgent;
+    if (urgentStream >= 0)
+    {
+        printf("Main:   urgent message every %d ms on stream %d\n", urgentMs, urgentStream);
+        eventBulkDone = CreateEvent(NULL, true, false, NULL);
+        urgent = std::thread(urgentRun, ss, urgentStream, urgentMs, eventBulkDone);
+    }
+    CompressionStage *compressor = NULL;
+    if (compressThreads > 0)
+    {
+        printf("Main:   compressing in %d KB blocks on %d threads\n", COMPRESS_BLOCK_SIZE >> 10, compressThreads);
+        // the compression workers read blocks out of order, so they need the whole buffer
+        init->WaitUntil(byteBufferSize);
+        compressor = new CompressionStage(charBuf, byteBufferSize, compressThreads);
+
+        // pack the compressed blocks back to back into full-size packets
+        char *pending = new char[payloadSize];
+        int pendingBytes = 0;
+        char *block;
+        int blockBytes;
+        bool more = compressor->Next(block, blockBytes);
+        while (more || pendingBytes > 0)
+        {
+            while (more && pendingBytes < payloadSize)
+            {
+                int bytes = min(blockBytes, payloadSize - pendingBytes);
+                memcpy(pending + pendingBytes, block, bytes);
+                pendingBytes += bytes;
+                block += bytes;
+                blockBytes -= bytes;
+                if (blockBytes == 0)
+                {
+                    more = compressor->Next(block, blockBytes);
+                }
+            }
+
+            if ((status = sock->Send(pending, pendingBytes)) != STATUS_OK)
+            {
+                printf("send failed with status %d\n", status);
+                delete[] pending;
+                delete compressor;
+                delete init;
+                cleanUpWinsock();
+                exit(EXIT_FAILURE);
+            }
+            pendingBytes = 0;
+        }
+        delete[] pending;
+        wireBytes = compressor->getCompressedBytes();
+    }
+    else
     {
-        // decide the size of next chunk
-        int bytes = (int)min((byteBufferSize - off), (uint64_t)(MAX_PKT_SIZE - sizeof(SenderDataHeader)));
-        // int bytes = (int)min((byteBufferSize - off), (uint64_t)(DUMMY_PKT_SIZE - sizeof(SenderDataHeader)));
-        // send chunk into socket
-        if ((status = ss.Send(charBuf + off, bytes)) != STATUS_OK)
+        uint64_t off = startOffset; // current position in buffer
+        uint64_t ready = 0;         // filled prefix, only behind off with -o
+        while (off < byteBufferSize)
         {
-            // error handing: print status and quit
-            printf("send failed with status %d\n", status);
-            delete[] dwordBuf;
-            cleanUpWinsock();
-            exit(EXIT_FAILURE);
+            // decide the size of next chunk
+            int bytes = (int)min((byteBufferSize - off), (uint64_t)payloadSize);
+            if (off + bytes > ready)
+            {
+                ready = init->WaitUntil(off + bytes);
+            }
+            // send chunk into socket
+            if ((status = sock->Send(charBuf + off, bytes)) != STATUS_OK)
+            {
+                // error handing: print status and quit
+                printf("send failed with status %d\n", status);
+                if (checkpointPath)
+                {
+                    printf("Main:   progress saved to %s, run again with -c to resume\n", checkpointPath);
+                }
+                delete init;
+                cleanUpWinsock();
+                exit(EXIT_FAILURE);
+            }
+            off += bytes;
         }
-        off += bytes;
+    }
+
+    if (urgentStream >= 0)
+    {
+        SetEvent(eventBulkDone);
+        urgent.join();
+        CloseHandle(eventBulkDone);
     }
 
     // close connection
     double elapsedTime;
-    status = ss.Close(elapsedTime);
+    status = sock->Close(elapsedTime);
     double seconds = elapsedTime - s;
     if (status != STATUS_OK)
     {
@@ -136,18 +496,59 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    if (checkpointPath)
+    {
+        remove(checkpointPath);
+    }
+
+    if (overlapInit)
+    {
+        init->Join();
+        printf("Main:   buffer initialized in %lld ms alongside the transfer\n", init->getElapsedMs());
+    }
+
     Checksum cs;
     DWORD chkSum = cs.CRC32((unsigned char *)charBuf, byteBufferSize);
-    double measuredRate = ((byteBufferSize * 8) / (1e3)) / seconds;
+    double measuredRate = ((wireBytes * 8) / (1e3)) / seconds;
     printf("Main:   transfer finished in %.3f sec, %.2f Kbps, checksum %X\n", seconds, measuredRate, chkSum);
 
-    double estRTT = ss.getEstRTT();
+    if (compressor)
+    {
+        // goodput counts the original bytes delivered; an uncompressed transfer cannot beat the
+        // emulated link, so the gain is measured against its rate
+        double effectiveRate = ((byteBufferSize * 8) / (1e3)) / seconds;
+        printf("Main:   compressed %.2f MB to %.2f MB (ratio %.2f), effective goodput %.2f Kbps", byteBufferSize / 1e6,
+               wireBytes / 1e6, compressor->getRatio(), effectiveRate);
+        if (linkSpeed > 0)
+        {
+            printf(" (%.2fx the %d Mbps link)", effectiveRate / (lp.speed / 1e3), linkSpeed);
+        }
+        printf("\n");
+        delete compressor;
+    }
+
+    for (int i = 0; urgentStream >= 0 && i <= urgentStream; ++i)
+    {
+        const SendStream *st = ss->getStream(i);
+        printf("Main:   stream %d (%s) %.2f MB, delay avg %.1f ms, max %.1f ms, slot wait max %.1f ms\n", i,
+               st->mode == STREAM_STRICT ? "strict" : "weighted", st->ackedBytes / 1e6,
+               st->ackedPkts ? 1e3 * st->delaySum / st->ackedPkts : 0.0, 1e3 * st->maxDelay, 1e3 * st->maxWait);
+    }
+
+    if (tracePath)
+    {
+        trace.Close();
+        printf("Main:   packet trace written to %s\n", tracePath);
+    }
+
+    double estRTT = sock->getEstRTT();
     double idealRate = ((MAX_PKT_SIZE - sizeof(SenderDataHeader)) * 8 * senderWindow) / (estRTT * 1e3);
     printf("Main:   estRTT %.3f, ideal rate %.2f Kbps\n", estRTT, idealRate);
 
+    delete sock;
     cleanUpWinsock();
 
-    delete[] dwordBuf;
+    delete init;
     return 0;
 }
 
@@ -26,7 +26,9 @@ public:
 class Flags
 {
 public:
-    DWORD reserved : 5; // must be zero
+    DWORD reserved : 3;   // must be zero
+    DWORD COMPRESSED : 1; // SYN of a connection whose payload is a stream of compressed blocks
+    DWORD STREAM : 1;     // data packet carries a SenderStreamHeader
     DWORD SYN : 1;
     DWORD ACK : 1;
     DWORD FIN : 1;
@@ -49,6 +51,22 @@ public:
     SenderDataHeader sdh;
     LinkProperties lp;
 };
+// SYN asking to continue at sdh.seq, the receiver checks crc against what it delivered
+class SenderResumeHeader
+{
+public:
+    SenderSynHeader ssh;
+    DWORD crc;     // CRC32 of the payload of seq 0 .. sdh.seq - 1
+    DWORD session; // new per sender process, tells a restarted sender from a retransmitted SYN
+};
+// data packet of a multiplexed connection; streamSeq orders each stream on its own
+class SenderStreamHeader
+{
+public:
+    SenderDataHeader sdh;
+    WORD streamId;
+    DWORD streamSeq;
+};
 class ReceiverHeader
 {
 public:
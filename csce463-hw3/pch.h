@@ -15,11 +15,23 @@
 	#pragma comment(lib, "Ws2_32.lib")
 
 #include "SenderSocket.h"
+#include "FanoutSenderSocket.h"
+#include "StreamScheduler.h"
+#include "BufferInit.h"
+#include "Compressor.h"
+#include "RunningChecksum.h"
+#include "ReceiverEngine.h"
+#include "PacketTrace.h"
+#include "TraceReplay.h"
+#include "SelfTest.h"
+#include "TransferCheckpoint.h"
 #include "PacketHeaders.h"
 #include "checksum.h"
+#include <cerrno>
 #include <cstdio>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <chrono>
 
 #endif //PCH_H